@@ -0,0 +1,42 @@
+// ECE 430.322: Computer Organization
+// Lab 4: Memory System Simulation
+
+#ifndef __BARRIER_H__
+#define __BARRIER_H__
+
+#include <condition_variable>
+#include <mutex>
+
+/***
+ *
+ * @class thread barrier (barrier_c)
+ *
+ * Each of the m_count threads blocks in wait() until all of them have
+ * arrived. The barrier is reusable: the generation number tells the waiters
+ * of one round apart from the early arrivals of the next.
+ */
+class barrier_c {
+public:
+  barrier_c(int count) : m_count(count), m_waiting(0), m_generation(0) {}
+
+  void wait() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    unsigned generation = m_generation;
+    if (++m_waiting == m_count) {
+      m_waiting = 0;
+      m_generation++;
+      m_cv.notify_all();
+      return;
+    }
+    m_cv.wait(lock, [&] { return generation != m_generation; });
+  }
+
+private:
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  int m_count;                   ///< # threads to wait for
+  int m_waiting;                 ///< # threads arrived in this round
+  unsigned m_generation;         ///< round number
+};
+
+#endif // !__BARRIER_H__
@@ -40,12 +40,26 @@ struct mem_req_s {
                          
   bool     m_done;       ///< request done? (data returned?)
   bool     m_dirty;      
+
+  int      m_pf_level;   ///< cache level that issued this prefetch (0: demand request)
+  int      m_core_id;    ///< core that initiated the request
+  bool     m_shared;     ///< MESI: the line is granted in S
   
   mem_req_s(addr_t addr, int access_type) {
     m_addr = addr;
     m_type = access_type;
     m_size = 0;
+    m_pf_level = 0;
+    m_core_id = 0;
+    m_shared = false;
   };
 };
 
+/// one access of a batch (memory_hierarchy_c::access_batch)
+struct mem_access_s {
+  addr_t   m_addr;
+  int      m_type;
+  uint32_t m_size;
+};
+
 #endif // !__MEM_REQ_H__
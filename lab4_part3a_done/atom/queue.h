@@ -16,9 +16,8 @@
  * This is used for internal queues for memory requests.  Note that this
  * differs from the C++ STL queue because this models a back pressure.  If
  * m_size is zero, there is no limit on the number of entries that a queue can
- * hold (i.e., no back pressure).  
- *
- * @note DO NOT MODIFY THIS!
+ * hold (i.e., no back pressure).  A batch of requests can also be pushed
+ * with a single insertion; the batch is cut to the entries that fit.
  */
 
 class queue_c {
@@ -42,6 +41,13 @@ public:
     return true;
   }
 
+  /// push requests in order with one insertion; returns how many fit
+  int push(mem_req_s* const* reqs, int num) {
+    if (m_size) num = std::min(num, (int)(m_size - m_entry.size()));
+    m_entry.insert(m_entry.end(), reqs, reqs + num);
+    return num;
+  }
+
   /// pop from the queue 
   void pop(mem_req_s* req) { 
     m_entry.erase(std::remove(m_entry.begin(), m_entry.end(), req), m_entry.end());
@@ -0,0 +1,217 @@
+// ECE 430.322: Computer Organization
+// Lab 4: Memory System Simulation
+
+#ifndef __SHM_RING_H__
+#define __SHM_RING_H__
+
+#include "global.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/***
+ *
+ * @class shared-memory trace ring (shm_ring_c)
+ *
+ * This passes trace records from a tracer to the simulator through a POSIX
+ * shared-memory object, with no file I/O. The producer create()s the ring,
+ * push()es records and calls finish() at the end; the simulator attach()es
+ * to it by name (a trace named "shm:<name>") and pop()s the records. The
+ * ring is single-producer single-consumer: the producer publishes records
+ * by a release store of the tail count and the consumer frees them by a
+ * release store of the head count, so neither side takes a lock. A side
+ * that finds the ring full (or empty) yields until the other catches up.
+ * The consumer removes the shared-memory object once it has read the last
+ * record.
+ *
+ * A crashed run can leave a ring behind. The header records the pid of the
+ * producer, and attach() skips a ring whose producer is gone before it
+ * finished, or that a consumer has already read from, and waits for a new
+ * producer to replace it. attach() gives up after a timeout, and pop()
+ * stops if the producer exits without calling finish().
+ */
+class shm_ring_c {
+public:
+  static const uint64_t DEFAULT_CAPACITY = 1 << 16;   ///< records (a power of two)
+  static const int DEFAULT_ATTACH_TIMEOUT = 10000;     ///< ms attach() waits for a producer
+
+  shm_ring_c() : m_header(nullptr), m_records(nullptr), m_map_size(0) {}
+  ~shm_ring_c() { close(); }
+
+  /// producer: create the ring (replacing a stale one of the same name)
+  bool create(const std::string& name, uint64_t capacity = DEFAULT_CAPACITY) {
+    close();
+    m_name = shm_name(name);
+    if (capacity == 0 || (capacity & (capacity - 1))) return false;
+
+    shm_unlink(m_name.c_str());
+    int fd = shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) return false;
+    m_map_size = sizeof(header_s) + capacity * sizeof(record_s);
+    bool ok = (ftruncate(fd, m_map_size) == 0) && map(fd);
+    ::close(fd);
+    if (!ok) return false;
+
+    m_header->m_capacity = capacity;
+    m_header->m_producer = getpid();
+    m_header->m_head.store(0, std::memory_order_relaxed);
+    m_header->m_tail.store(0, std::memory_order_relaxed);
+    m_header->m_done.store(0, std::memory_order_relaxed);
+    m_header->m_ready.store(1, std::memory_order_release);
+    m_tail = 0;
+    m_head_seen = 0;
+    return true;
+  }
+
+  /// consumer: attach to a ring, waiting up to timeout_ms until a live producer has created it
+  bool attach(const std::string& name, int timeout_ms = DEFAULT_ATTACH_TIMEOUT) {
+    close();
+    m_name = shm_name(name);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    bool stale = false;
+    while (true) {
+      if (map_ready()) {
+        if (m_header->m_head.load(std::memory_order_acquire) == 0 &&
+            (m_header->m_done.load(std::memory_order_acquire) || is_producer_alive()))
+          break;
+        stale = true;  // a new producer replaces it
+        close();
+      }
+      if (std::chrono::steady_clock::now() >= deadline) {
+        std::cerr << "shm ring " << m_name << ": "
+                  << (stale ? "only a stale ring (its producer or consumer is gone)" : "no producer")
+                  << " after " << timeout_ms << " ms\n";
+        return false;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    m_head = 0;
+    m_tail_seen = 0;
+    return true;
+  }
+
+  bool is_open() const { return m_header != nullptr; }
+
+  /// producer: append a record, waiting while the ring is full
+  void push(int type, addr_t address, uint32_t size = 0) {
+    uint64_t capacity = m_header->m_capacity;
+    while (m_tail - m_head_seen == capacity) {
+      m_head_seen = m_header->m_head.load(std::memory_order_acquire);
+      if (m_tail - m_head_seen == capacity) std::this_thread::yield();
+    }
+    m_records[m_tail & (capacity - 1)] = record_s{address, type, size};
+    m_header->m_tail.store(++m_tail, std::memory_order_release);
+  }
+
+  /// producer: no more records
+  void finish() {
+    m_header->m_done.store(1, std::memory_order_release);
+  }
+
+  /// consumer: the next record; false once the producer has finished and the ring is empty
+  bool pop(int& type, addr_t& address, uint32_t& size) {
+    for (uint64_t spins = 1; m_head == m_tail_seen; ++spins) {
+      // m_done is read first: every record pushed before finish() is then visible
+      bool done = m_header->m_done.load(std::memory_order_acquire);
+      m_tail_seen = m_header->m_tail.load(std::memory_order_acquire);
+      if (m_head != m_tail_seen) break;
+      if (done) {
+        shm_unlink(m_name.c_str());
+        return false;
+      }
+      if (spins % 4096 == 0 && !is_producer_alive()) {
+        std::cerr << "shm ring " << m_name << ": the producer exited without finishing\n";
+        return false;
+      }
+      std::this_thread::yield();
+    }
+
+    const record_s& record = m_records[m_head & (m_header->m_capacity - 1)];
+    type = record.m_type;
+    address = record.m_addr;
+    size = record.m_size;
+    m_header->m_head.store(++m_head, std::memory_order_release);
+    return true;
+  }
+
+  void close() {
+    if (m_header) munmap(m_header, m_map_size);
+    m_header = nullptr;
+    m_records = nullptr;
+  }
+
+private:
+  struct header_s {
+    std::atomic<uint32_t> m_ready;        ///< set by the producer once the header is valid
+    std::atomic<uint32_t> m_done;         ///< the producer has finished
+    int32_t  m_producer;                  ///< pid of the producer
+    uint64_t m_capacity;
+    alignas(64) std::atomic<uint64_t> m_head;   ///< # records popped
+    alignas(64) std::atomic<uint64_t> m_tail;   ///< # records pushed
+  };
+
+  struct record_s {
+    addr_t   m_addr;
+    int      m_type;
+    uint32_t m_size;              ///< bytes (0: unknown)
+  };
+
+  static std::string shm_name(const std::string& name) {
+    return name.empty() || name[0] != '/' ? "/" + name : name;
+  }
+
+  /// consumer: map the ring if it exists and its producer has set it up
+  bool map_ready() {
+    int fd = shm_open(m_name.c_str(), O_RDWR, 0600);
+    if (fd < 0) return false;
+    struct stat st;
+    bool ok = (fstat(fd, &st) == 0 && st.st_size > (off_t)sizeof(header_s));
+    if (ok) {
+      m_map_size = st.st_size;
+      ok = map(fd);
+    }
+    ::close(fd);
+    if (!ok) return false;
+
+    if (!m_header->m_ready.load(std::memory_order_acquire) ||
+        m_map_size != sizeof(header_s) + m_header->m_capacity * sizeof(record_s)) {
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  bool is_producer_alive() const {
+    return kill(m_header->m_producer, 0) == 0 || errno == EPERM;
+  }
+
+  bool map(int fd) {
+    void* map = mmap(nullptr, m_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) return false;
+    m_header = (header_s*)map;
+    m_records = (record_s*)(m_header + 1);
+    return true;
+  }
+
+  std::string m_name;
+  header_s* m_header;
+  record_s* m_records;
+  size_t m_map_size;
+
+  uint64_t m_tail;                ///< producer: # records pushed
+  uint64_t m_head_seen;           ///< producer: last head count read
+  uint64_t m_head;                ///< consumer: # records popped
+  uint64_t m_tail_seen;           ///< consumer: last tail count read
+};
+
+#endif // !__SHM_RING_H__
@@ -0,0 +1,94 @@
+// ECE 430.322: Computer Organization
+// Lab 4: Memory System Simulation
+
+#ifndef __SPSC_QUEUE_H__
+#define __SPSC_QUEUE_H__
+
+#include <atomic>
+#include <cstddef>
+
+/***
+ *
+ * @class single-producer single-consumer queue (spsc_queue_c)
+ *
+ * This is an unbounded lock-free FIFO between exactly two threads: one thread
+ * only pushes, and the other only reads (front/pop). Entries are stored in a
+ * linked list of fixed-size blocks. The producer publishes an entry by a
+ * release store of the tail index, and the consumer sees it through an
+ * acquire load, so neither side ever takes a lock or waits for the other.
+ */
+template <typename T>
+class spsc_queue_c {
+public:
+  spsc_queue_c() {
+    m_head_block = m_tail_block = new block_s();
+  }
+
+  ~spsc_queue_c() {
+    while (m_head_block) {
+      block_s* next = m_head_block->m_next.load(std::memory_order_relaxed);
+      delete m_head_block;
+      m_head_block = next;
+    }
+  }
+
+  /// producer: append an entry
+  void push(const T& entry) {
+    ++m_num_pushed;
+    block_s* block = m_tail_block;
+    size_t tail = block->m_tail.load(std::memory_order_relaxed);
+    if (tail == block_size) {
+      // the current block is full; link a new one
+      block_s* next = new block_s();
+      next->m_entry[0] = entry;
+      next->m_tail.store(1, std::memory_order_relaxed);
+      block->m_next.store(next, std::memory_order_release);
+      m_tail_block = next;
+      return;
+    }
+    block->m_entry[tail] = entry;
+    block->m_tail.store(tail + 1, std::memory_order_release);
+  }
+
+  /// producer: # entries pushed so far
+  size_t get_num_pushed() const { return m_num_pushed; }
+
+  /// consumer: the oldest entry, or nullptr if the queue is empty
+  T* front() {
+    if (m_head == m_head_block->m_tail.load(std::memory_order_acquire)) {
+      if (m_head < block_size) return nullptr;
+
+      // the block is used up; move on to the next one if it exists
+      block_s* next = m_head_block->m_next.load(std::memory_order_acquire);
+      if (!next) return nullptr;
+      delete m_head_block;
+      m_head_block = next;
+      m_head = 0;
+      if (m_head == m_head_block->m_tail.load(std::memory_order_acquire)) return nullptr;
+    }
+    return &m_head_block->m_entry[m_head];
+  }
+
+  /// consumer: remove the entry returned by front()
+  void pop() { ++m_head; }
+
+  /// consumer: true if there is nothing to read
+  bool empty() { return front() == nullptr; }
+
+private:
+  static const size_t block_size = 1024;
+
+  struct block_s {
+    block_s() : m_tail(0), m_next(nullptr) {}
+    T m_entry[block_size];
+    std::atomic<size_t> m_tail;       ///< # entries written (producer)
+    std::atomic<block_s*> m_next;     ///< next block (producer links, consumer frees)
+  };
+
+  block_s* m_head_block;              ///< consumer side
+  size_t   m_head = 0;                ///< next entry to read in m_head_block
+  block_s* m_tail_block;              ///< producer side
+  size_t   m_num_pushed = 0;          ///< producer side
+};
+
+#endif // !__SPSC_QUEUE_H__
@@ -0,0 +1,190 @@
+// ECE 430.322: Computer Organization
+// Lab 4: Memory System Simulation
+
+#ifndef __TRACE_ADAPTER_H__
+#define __TRACE_ADAPTER_H__
+
+#include "global.h"
+#include "mem_req.h"
+#include "trace_parser.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+/***
+ *
+ * @class foreign trace adapter (trace_adapter_c)
+ *
+ * This decodes traces of other tools into (type, address, size) records as
+ * they stream in, so they need no conversion to the text format:
+ *  - Valgrind Lackey (--tool=lackey --trace-mem=yes): "I  addr,size",
+ *    " L addr,size", " S addr,size" and " M addr,size" lines; an M (modify)
+ *    is a load followed by a store. Lines starting with "==" are skipped.
+ *  - ChampSim (uncompressed): 64-byte input_instr records; an instruction
+ *    is its fetch, then its source memory operands as loads and its
+ *    destination memory operands as stores. ChampSim has no sizes (0).
+ * The input is read in BUFFER_SIZE blocks with read(2) and decoded in
+ * place, with no per-line allocation or scanf.
+ */
+class trace_adapter_c {
+public:
+  enum FORMAT {
+    FORMAT_LACKEY = 0,
+    FORMAT_CHAMPSIM
+  };
+
+  static const size_t BUFFER_SIZE = 1 << 20;
+
+  trace_adapter_c() : m_fd(-1) {}
+  ~trace_adapter_c() { close(); }
+
+  /// path: a file, a FIFO or "-" (stdin)
+  bool open(const std::string& path, int format) {
+    close();
+    m_fd = (path == "-") ? dup(0) : ::open(path.c_str(), O_RDONLY);
+    if (m_fd < 0) return false;
+    m_format = format;
+    m_buf.resize(BUFFER_SIZE);
+    m_pos = m_end = 0;
+    m_eof = false;
+    m_num_pending = m_next_pending = 0;
+    return true;
+  }
+
+  void close() {
+    if (m_fd >= 0) ::close(m_fd);
+    m_fd = -1;
+  }
+
+  /// the next record; false at the end of the trace
+  bool next(int& type, addr_t& address, uint32_t& size) {
+    while (m_next_pending == m_num_pending) {
+      m_num_pending = m_next_pending = 0;
+      bool ok = (m_format == FORMAT_LACKEY) ? decode_lackey() : decode_champsim();
+      if (!ok) return false;
+    }
+
+    const record_s& record = m_pending[m_next_pending++];
+    type = record.m_type;
+    address = record.m_addr;
+    size = record.m_size;
+    return true;
+  }
+
+private:
+  struct record_s {
+    addr_t   m_addr;
+    int      m_type;
+    uint32_t m_size;
+  };
+
+  /// ChampSim's input_instr
+  struct champsim_instr_s {
+    uint64_t m_ip;
+    uint8_t  m_is_branch;
+    uint8_t  m_branch_taken;
+    uint8_t  m_dst_regs[2];
+    uint8_t  m_src_regs[4];
+    uint64_t m_dst_mem[2];
+    uint64_t m_src_mem[4];
+  };
+  static_assert(sizeof(champsim_instr_s) == 64, "ChampSim input_instr is 64 bytes");
+
+  void add(int type, addr_t address, uint32_t size) {
+    m_pending[m_num_pending++] = record_s{address, type, size};
+  }
+
+  /// keep the unread bytes and read more; false if nothing was added
+  bool fill() {
+    if (m_eof) return false;
+    memmove(m_buf.data(), m_buf.data() + m_pos, m_end - m_pos);
+    m_end -= m_pos;
+    m_pos = 0;
+    size_t start = m_end;
+    while (m_end < m_buf.size()) {
+      ssize_t num_read = read(m_fd, m_buf.data() + m_end, m_buf.size() - m_end);
+      if (num_read <= 0) {
+        m_eof = true;
+        break;
+      }
+      m_end += num_read;
+      if (m_format == FORMAT_LACKEY) break;   // a line is enough
+    }
+    return m_end > start;
+  }
+
+  /// the records of the next memory line; false at the end of the trace
+  bool decode_lackey() {
+    while (true) {
+      const char* line = m_buf.data() + m_pos;
+      const char* eol = (const char*)memchr(line, '\n', m_end - m_pos);
+      if (!eol) {
+        if (m_end - m_pos < m_buf.size() && fill()) continue;
+        if (m_pos == m_end) return false;
+        eol = m_buf.data() + m_end;      // the last line (or a line longer than the buffer)
+      }
+      m_pos = std::min((size_t)(eol - m_buf.data()) + 1, m_end);
+
+      const char* p = line;
+      while (p < eol && *p == ' ') ++p;
+      if (eol - p < 3 || p[1] != ' ') continue;   // "==pid== ..." and other lines
+      char kind = p[0];
+      p += 2;
+      while (p < eol && *p == ' ') ++p;
+
+      addr_t address = 0;
+      int digit;
+      for (; p < eol && (digit = trace_parser_c::hex_digit(*p)) >= 0; ++p) address = (address << 4) | digit;
+      uint32_t size = 0;
+      if (p < eol && *p == ',') {
+        for (++p; p < eol && *p >= '0' && *p <= '9'; ++p) size = size * 10 + (*p - '0');
+      }
+
+      switch (kind) {
+        case 'I': add(REQ_IFETCH, address, size); return true;
+        case 'L': add(REQ_DFETCH, address, size); return true;
+        case 'S': add(REQ_DSTORE, address, size); return true;
+        case 'M': add(REQ_DFETCH, address, size); add(REQ_DSTORE, address, size); return true;
+        default: break;
+      }
+    }
+  }
+
+  /// the records of the next instruction; false at the end of the trace
+  bool decode_champsim() {
+    if (m_end - m_pos < sizeof(champsim_instr_s) && (!fill() || m_end - m_pos < sizeof(champsim_instr_s))) {
+      return false;
+    }
+
+    champsim_instr_s instr;
+    memcpy(&instr, m_buf.data() + m_pos, sizeof(instr));
+    m_pos += sizeof(instr);
+
+    add(REQ_IFETCH, instr.m_ip, 0);
+    for (auto address : instr.m_src_mem) {
+      if (address) add(REQ_DFETCH, address, 0);
+    }
+    for (auto address : instr.m_dst_mem) {
+      if (address) add(REQ_DSTORE, address, 0);
+    }
+    return true;
+  }
+
+  int m_fd;
+  int m_format;
+  std::vector<char> m_buf;
+  size_t m_pos;                  ///< next byte to decode
+  size_t m_end;                  ///< end of the bytes read
+  bool m_eof;
+
+  record_s m_pending[8];         ///< records of the line/instruction decoded last
+  int m_num_pending;
+  int m_next_pending;
+};
+
+#endif // !__TRACE_ADAPTER_H__
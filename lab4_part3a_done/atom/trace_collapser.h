@@ -0,0 +1,57 @@
+// ECE 430.322: Computer Organization
+// Lab 4: Memory System Simulation
+
+#ifndef __TRACE_COLLAPSER_H__
+#define __TRACE_COLLAPSER_H__
+
+#include "global.h"
+#include "trace_reader.h"
+
+/***
+ *
+ * @class same-line run collapser (trace_collapser_c)
+ *
+ * This reads a trace and merges each run of consecutive records of the same
+ * type to the same line into one record with a repeat count (the address
+ * is that of the first record of the run). After the first access of a
+ * run, the line is the MRU line of its set, so the rest of the run hits and
+ * changes nothing but the statistics (cache_base_c::repeat_hits()); a cache
+ * with LRU replacement gives exactly the same results. Runs are common in
+ * instruction fetch streams, where consecutive instructions share a line.
+ *
+ * It works online, between the trace reader and the cache, or offline:
+ * cache_base/collapse_trace writes the collapsed records as
+ * "<type> <hex address> <repeat>" lines, which the trace reader reads back.
+ */
+class trace_collapser_c {
+public:
+  trace_collapser_c(trace_reader_c& reader, int line_size)
+      : m_reader(reader), m_line_size(line_size), m_has_next(false) {}
+
+  /// the next run; false at the end of the trace
+  bool next(int& type, addr_t& address, uint32_t& repeat) {
+    uint32_t size;
+    if (!m_has_next && !m_reader.next(m_next_type, m_next_addr, size, m_next_repeat)) return false;
+
+    type = m_next_type;
+    address = m_next_addr;
+    repeat = m_next_repeat;
+    addr_t line = address / m_line_size;
+    while ((m_has_next = m_reader.next(m_next_type, m_next_addr, size, m_next_repeat))) {
+      if (m_next_type != type || m_next_addr / m_line_size != line) break;
+      repeat += m_next_repeat;
+    }
+    return true;
+  }
+
+private:
+  trace_reader_c& m_reader;
+  int m_line_size;
+
+  bool m_has_next;              ///< the record after the last run was read
+  int m_next_type;
+  addr_t m_next_addr;
+  uint32_t m_next_repeat;
+};
+
+#endif // !__TRACE_COLLAPSER_H__
@@ -0,0 +1,240 @@
+// ECE 430.322: Computer Organization
+// Lab 4: Memory System Simulation
+
+#ifndef __TRACE_PARSER_H__
+#define __TRACE_PARSER_H__
+
+#include "global.h"
+
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/***
+ *
+ * @class parallel trace parser (trace_parser_c)
+ *
+ * This parses a text trace on a pool of threads. The trace is mapped with
+ * mmap and cut into CHUNK_SIZE pieces, each moved to the next line start,
+ * so every line belongs to exactly one chunk. A worker takes the next chunk
+ * number, parses it into a record array in its slot of a ring of
+ * 2 * num_threads slots, and marks the slot ready. next() returns the
+ * records chunk by chunk in trace order and frees a slot once it is used
+ * up, so the workers stay at most a ring ahead of the simulation.
+ */
+class trace_parser_c {
+public:
+  static const uint64_t CHUNK_SIZE = 1 << 20;
+
+  trace_parser_c() : m_data(nullptr), m_size(0) {}
+  ~trace_parser_c() { close(); }
+
+  bool open(const std::string& filename, int num_threads) {
+    close();
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      ::close(fd);
+      return false;
+    }
+    m_size = st.st_size;
+    void* map = m_size ? mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+    ::close(fd);
+    if (map == MAP_FAILED) return false;
+    if (map) madvise(map, m_size, MADV_SEQUENTIAL);
+
+    m_data = (const char*)map;
+    m_num_threads = num_threads;
+    m_chunks.resize(2 * num_threads);
+    start(0);
+    return true;
+  }
+
+  void close() {
+    stop_workers();
+    if (m_data) munmap((void*)m_data, m_size);
+    m_data = nullptr;
+    m_size = 0;
+  }
+
+  /// (re)start parsing at a line start
+  void start(uint64_t offset) {
+    stop_workers();
+    m_start = offset < m_size ? offset : m_size;
+    m_num_ids = (m_size - m_start + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    m_next_id = 0;
+    m_consumed = 0;
+    m_cur = nullptr;
+    m_cur_idx = 0;
+    for (auto& chunk : m_chunks) chunk.m_id = -1;
+
+    m_stop = false;
+    for (int ii = 0; ii < m_num_threads; ++ii) {
+      m_threads.emplace_back(&trace_parser_c::worker, this);
+    }
+  }
+
+  /// the next record and the byte offset of the one after it; false at the end of the trace
+  bool next(int& type, addr_t& address, uint32_t& repeat, uint64_t& next_offset) {
+    while (!m_cur || m_cur_idx == m_cur->m_records.size()) {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      if (m_cur) {
+        m_cur = nullptr;
+        m_consumed++;
+        m_cv_free.notify_all();
+      }
+      if (m_consumed == m_num_ids) return false;
+
+      chunk_s& chunk = m_chunks[m_consumed % m_chunks.size()];
+      m_cv_ready.wait(lock, [&] { return chunk.m_id == m_consumed; });
+      m_cur = &chunk;
+      m_cur_idx = 0;
+    }
+
+    const record_s& record = m_cur->m_records[m_cur_idx++];
+    type = record.m_type;
+    address = record.m_addr;
+    repeat = record.m_repeat;
+    next_offset = m_cur_idx < m_cur->m_records.size() ? m_cur->m_begin + m_cur->m_records[m_cur_idx].m_pos
+                                                      : m_cur->m_end;
+    return true;
+  }
+
+  /**
+   * "<type> <hex address> [<repeat>]": the first two fields as
+   * sscanf("%d %lx") reads them (a field that cannot be read leaves its
+   * output unchanged), and the repeat count of a collapsed run (1 if absent).
+   */
+  static void parse_record(const char* p, const char* end, int& type, addr_t& address, uint32_t& repeat) {
+    repeat = 1;
+    while (p < end && (*p == ' ' || *p == '\t')) ++p;
+    bool negative = (p < end && *p == '-');
+    if (p < end && (*p == '-' || *p == '+')) ++p;
+    if (p == end || *p < '0' || *p > '9') return;
+    int value = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p) value = value * 10 + (*p - '0');
+    type = negative ? -value : value;
+
+    while (p < end && (*p == ' ' || *p == '\t')) ++p;
+    if (end - p > 2 && p[0] == '0' && (p[1] | 0x20) == 'x' && hex_digit(p[2]) >= 0) p += 2;
+    if (p == end || hex_digit(*p) < 0) return;
+    addr_t addr = 0;
+    for (int digit; p < end && (digit = hex_digit(*p)) >= 0; ++p) addr = (addr << 4) | digit;
+    address = addr;
+
+    while (p < end && (*p == ' ' || *p == '\t')) ++p;
+    if (p == end || *p < '1' || *p > '9') return;
+    uint32_t count = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p) count = count * 10 + (*p - '0');
+    repeat = count;
+  }
+
+  /// value of a hex digit (-1: not one)
+  static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    c |= 0x20;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+  }
+
+private:
+  struct record_s {
+    addr_t   m_addr;
+    uint32_t m_pos;             ///< byte offset in the chunk
+    int      m_type;
+    uint32_t m_repeat;
+  };
+
+  struct chunk_s {
+    int64_t  m_id;              ///< chunk number parsed into this slot (-1: none)
+    uint64_t m_begin;           ///< byte offset of its first line
+    uint64_t m_end;             ///< byte offset after its last line
+    std::vector<record_s> m_records;
+  };
+
+  /// the first line start at or after offset
+  uint64_t line_start(uint64_t offset) const {
+    if (offset <= m_start) return m_start;
+    if (offset >= m_size) return m_size;
+    if (m_data[offset - 1] == '\n') return offset;
+    const char* eol = (const char*)memchr(m_data + offset, '\n', m_size - offset);
+    return eol ? eol - m_data + 1 : m_size;
+  }
+
+  void parse_chunk(int64_t id, chunk_s& chunk) {
+    chunk.m_begin = line_start(m_start + id * CHUNK_SIZE);
+    chunk.m_end = line_start(m_start + (id + 1) * CHUNK_SIZE);
+    chunk.m_records.clear();
+
+    const char* p = m_data + chunk.m_begin;
+    const char* end = m_data + chunk.m_end;
+    int type = 0;
+    addr_t address = 0;
+    uint32_t repeat;
+    while (p < end) {
+      const char* eol = (const char*)memchr(p, '\n', end - p);
+      if (!eol) eol = end;
+      parse_record(p, eol, type, address, repeat);
+      chunk.m_records.push_back(record_s{address, (uint32_t)(p - m_data - chunk.m_begin), type, repeat});
+      p = eol + 1;
+    }
+  }
+
+  void worker() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+      m_cv_free.wait(lock, [&] {
+        return m_stop || (m_next_id < m_num_ids && m_next_id < m_consumed + (int64_t)m_chunks.size());
+      });
+      if (m_stop) return;
+
+      int64_t id = m_next_id++;
+      chunk_s& chunk = m_chunks[id % m_chunks.size()];
+      lock.unlock();
+      parse_chunk(id, chunk);
+      lock.lock();
+      chunk.m_id = id;
+      m_cv_ready.notify_one();
+    }
+  }
+
+  void stop_workers() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+    m_cv_free.notify_all();
+    for (auto& thread : m_threads) thread.join();
+    m_threads.clear();
+  }
+
+  const char* m_data;                 ///< the mapped trace
+  uint64_t m_size;
+  uint64_t m_start;                   ///< byte offset parsing (re)started at
+  int m_num_threads;
+  std::vector<std::thread> m_threads;
+
+  std::mutex m_mutex;
+  std::condition_variable m_cv_free;  ///< a slot was freed (or stop)
+  std::condition_variable m_cv_ready; ///< a slot was filled
+  bool m_stop;
+  std::vector<chunk_s> m_chunks;      ///< slots; chunk id goes to slot id % size
+  int64_t m_num_ids;                  ///< # chunks from m_start to the end
+  int64_t m_next_id;                  ///< next chunk for a worker
+  int64_t m_consumed;                 ///< # chunks next() has used up
+
+  chunk_s* m_cur;                     ///< chunk next() reads from
+  size_t m_cur_idx;                   ///< next record in it
+};
+
+#endif // !__TRACE_PARSER_H__
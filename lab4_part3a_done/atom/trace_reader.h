@@ -0,0 +1,353 @@
+// ECE 430.322: Computer Organization
+// Lab 4: Memory System Simulation
+
+#ifndef __TRACE_READER_H__
+#define __TRACE_READER_H__
+
+#include "global.h"
+#include "shm_ring.h"
+#include "trace_adapter.h"
+#include "trace_parser.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+/***
+ *
+ * @class trace reader (trace_reader_c)
+ *
+ * This reads the records ("<type> <hex address>" per line) of a trace and
+ * can seek to any record number. A record is one access: a line of a
+ * collapsed trace ("<type> <hex address> <repeat>") is repeat records, so
+ * record numbers (tell(), seek(), and the trace_skip, fast_forward,
+ * sampling and checkpoint positions built on them) mean the same on a trace
+ * and on its collapsed version. The byte offset of every m_interval-th line,
+ * and the number of records before it, are kept in an index, which is built
+ * while the trace is streamed. seek() jumps to the closest indexed line and
+ * reads forward from there (extending the index if the target is beyond it),
+ * possibly stopping within a collapsed line.
+ *
+ * With the index file on, the index is loaded from the sidecar
+ * "<trace>.idx" when it matches the trace (its size, modification time, and
+ * a hash of its first and last 4 KB), and written there once a full pass
+ * has reached the end of the trace, so later runs can seek right away.
+ *
+ * With more than one thread, the records come from a trace_parser_c that
+ * parses the trace in chunks on that many threads instead of line by line
+ * on the caller's thread.
+ *
+ * A trace can also be a stream: "-" (stdin), a FIFO, or "shm:<name>" (the
+ * records a tracer pushes into a shm_ring_c). A stream is read once, line
+ * by line, without an index; seek() can only move forward, by reading
+ * the records in between.
+ *
+ * "lackey:<path>" and "champsim:<path>" read the trace of those tools
+ * (a file, a FIFO or "-") through a trace_adapter_c, also as a stream.
+ */
+class trace_reader_c {
+public:
+  static const counter DEFAULT_INTERVAL = 4096;
+
+  trace_reader_c() : m_is_open(false) {}
+
+  /// interval: lines between index entries; use_index_file: load/write "<trace>.idx"
+  bool open(const std::string& filename, counter interval = DEFAULT_INTERVAL, bool use_index_file = false,
+            int num_threads = 1) {
+    m_filename = filename;
+    m_interval = interval ? interval : DEFAULT_INTERVAL;
+    m_use_index_file = use_index_file && filename != "-";
+    m_index_written = false;
+    m_offsets.clear();
+    m_index_records.clear();
+    m_line = 0;
+    m_offset = 0;
+    m_record = 0;
+    m_run_left = 0;
+    m_parallel = false;
+    m_is_open = false;
+
+    m_from_ring = (filename.compare(0, 4, "shm:") == 0);
+    m_adapted = (filename.compare(0, 7, "lackey:") == 0 || filename.compare(0, 9, "champsim:") == 0);
+    if (m_adapted) {
+      bool lackey = (filename[0] == 'l');
+      m_stream = true;
+      m_use_index_file = false;
+      m_is_open = m_adapter.open(filename.substr(lackey ? 7 : 9),
+                                 lackey ? trace_adapter_c::FORMAT_LACKEY : trace_adapter_c::FORMAT_CHAMPSIM);
+      return m_is_open;
+    }
+    if (m_from_ring) {
+      m_stream = true;
+      m_use_index_file = false;
+      m_is_open = m_ring.attach(filename.substr(4));
+      return m_is_open;
+    }
+
+    // stdin redirected from a file can still be seeked
+    std::string path = (filename == "-") ? "/dev/stdin" : filename;
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return false;
+    m_stream = !S_ISREG(st.st_mode);
+    m_file.open(path);
+    if (!m_file.is_open()) return false;
+    if (m_stream) {
+      m_use_index_file = false;
+      m_is_open = true;
+      return true;
+    }
+
+    m_parallel = (num_threads > 1);
+    if (m_parallel && !m_parser.open(path, num_threads)) return false;
+
+    m_file_size = st.st_size;
+    if (m_use_index_file) {
+      m_mtime = (uint64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+      m_fingerprint = fingerprint(path);
+      if (load_index()) m_index_written = true;
+    }
+    m_is_open = true;
+    return true;
+  }
+
+  bool is_open() const { return m_is_open; }
+
+  /// the next record; false at the end of the trace
+  bool next(int& type, addr_t& address) {
+    uint32_t size;
+    return next(type, address, size);
+  }
+
+  /// the same, with the access size in bytes (0: not in the trace)
+  bool next(int& type, addr_t& address, uint32_t& size) {
+    if (!m_run_left && !read_line()) return false;
+    m_run_left--;
+    type = m_run_type;
+    address = m_run_addr;
+    size = m_run_size;
+    return true;
+  }
+
+  /**
+   * The next records up to the end of the current line at once: repeat
+   * records of the same access (> 1 for a collapsed run, or what is left of
+   * it after a seek() into it).
+   */
+  bool next(int& type, addr_t& address, uint32_t& size, uint32_t& repeat) {
+    if (!m_run_left && !read_line()) return false;
+    repeat = m_run_left;
+    m_run_left = 0;
+    type = m_run_type;
+    address = m_run_addr;
+    size = m_run_size;
+    return true;
+  }
+
+  /// move to record number "record" (the next one next() returns)
+  bool seek(counter record) {
+    if (m_stream) return skip_to(record);
+
+    // the last indexed line at or before the record
+    counter entry = std::upper_bound(m_index_records.begin(), m_index_records.end(), record) - m_index_records.begin();
+    if (entry > 0) entry--;
+    if (!seek_line(entry * m_interval, m_offsets.empty() ? 0 : m_offsets[entry],
+                   m_index_records.empty() ? 0 : m_index_records[entry]))
+      return false;
+    return skip_to(record);
+  }
+
+  /// a position in the trace, within a collapsed line too (e.g., for a checkpoint)
+  struct pos_s {
+    uint64_t m_line;            ///< lines read
+    uint64_t m_offset;          ///< byte offset of the next line
+    uint64_t m_record;          ///< records in the lines read
+    uint64_t m_run_addr;        ///< the last line read ...
+    int32_t  m_run_type;
+    uint32_t m_run_size;
+    uint32_t m_run_left;        ///< ... and its records not returned yet
+    uint32_t m_unused;
+  };
+
+  pos_s tell_pos() const {
+    return pos_s{m_line, m_offset, m_record, m_run_addr, m_run_type, m_run_size, m_run_left, 0};
+  }
+
+  /// move to a position from tell_pos()
+  bool seek(const pos_s& pos) {
+    if (m_stream) return skip_to(pos.m_record - pos.m_run_left);
+    if (!seek_line(pos.m_line, pos.m_offset, pos.m_record)) return false;
+    m_run_addr = pos.m_run_addr;
+    m_run_type = pos.m_run_type;
+    m_run_size = pos.m_run_size;
+    m_run_left = pos.m_run_left;
+    return true;
+  }
+
+  counter tell() const { return m_record - m_run_left; }  ///< number of the next record
+
+private:
+  /// read the next line into m_run_*
+  bool read_line() {
+    uint64_t next_offset;
+    uint32_t repeat = 1;
+    m_run_size = 0;
+    if (m_parallel) {
+      if (!m_parser.next(m_run_type, m_run_addr, repeat, next_offset)) return end_of_trace();
+    } else if (m_adapted) {
+      if (!m_adapter.next(m_run_type, m_run_addr, m_run_size)) return end_of_trace();
+      next_offset = m_offset;
+    } else if (m_from_ring) {
+      if (!m_ring.pop(m_run_type, m_run_addr, m_run_size)) return end_of_trace();
+      next_offset = m_offset;
+    } else {
+      if (!std::getline(m_file, m_text)) return end_of_trace();
+      next_offset = m_offset + m_text.size() + 1;
+      trace_parser_c::parse_record(m_text.data(), m_text.data() + m_text.size(), m_run_type, m_run_addr, repeat);
+    }
+
+    if (m_line % m_interval == 0 && m_line / m_interval == m_offsets.size()) {
+      m_offsets.push_back(m_offset);
+      m_index_records.push_back(m_record);
+    }
+    m_offset = next_offset;
+    m_line++;
+    m_record += repeat;
+    m_run_left = repeat;
+    return true;
+  }
+
+  /// move to a line whose byte offset and first record are known
+  bool seek_line(counter line, uint64_t offset, counter record) {
+    m_run_left = 0;
+    if (m_parallel) {
+      m_parser.start(offset);
+    } else {
+      m_file.clear();
+      m_file.seekg(offset);
+      if (!m_file.good()) return false;
+    }
+    m_line = line;
+    m_offset = offset;
+    m_record = record;
+    return !m_parallel || offset <= m_file_size;
+  }
+
+  /// read forward to record number "record", possibly into a collapsed line
+  bool skip_to(counter record) {
+    if (record < tell()) return false;
+    while (tell() < record) {
+      if (!m_run_left && !read_line()) return false;
+      m_run_left -= std::min<counter>(m_run_left, record - tell());
+    }
+    return true;
+  }
+
+  bool end_of_trace() {
+    if (m_use_index_file && !m_index_written && is_index_complete()) write_index();
+    return false;
+  }
+
+  /// the index has an entry for every m_interval-th line of the whole trace
+  bool is_index_complete() const {
+    return m_offset >= m_file_size && m_offsets.size() == (m_line + m_interval - 1) / m_interval;
+  }
+
+  struct index_header_s {
+    char     m_magic[8];
+    uint64_t m_interval;
+    uint64_t m_file_size;       ///< size of the trace it was built for
+    uint64_t m_mtime;           ///< modification time of that trace (ns)
+    uint64_t m_fingerprint;     ///< fingerprint() of that trace
+    uint64_t m_num_lines;
+    uint64_t m_num_offsets;     ///< entries (a byte offset, then a record number each)
+  };
+
+  static constexpr const char* INDEX_MAGIC = "L4TRCIX3";
+  static const int FINGERPRINT_CHUNK = 4096;
+
+  /// FNV-1a hash of the first and the last FINGERPRINT_CHUNK bytes of a file
+  uint64_t fingerprint(const std::string& path) const {
+    std::ifstream in(path, std::ios::binary);
+    std::vector<char> data(2 * FINGERPRINT_CHUNK);
+    uint64_t chunk = std::min<uint64_t>(m_file_size, FINGERPRINT_CHUNK);
+    in.read(data.data(), chunk);
+    in.seekg(m_file_size - chunk);
+    in.read(data.data() + chunk, chunk);
+
+    uint64_t hash = 14695981039346656037ull;
+    for (uint64_t ii = 0; ii < 2 * chunk; ++ii) {
+      hash = (hash ^ (unsigned char)data[ii]) * 1099511628211ull;
+    }
+    return hash;
+  }
+
+  bool load_index() {
+    std::ifstream in(m_filename + ".idx", std::ios::binary);
+    index_header_s header;
+    if (!in.read((char*)&header, sizeof(header))) return false;
+    if (memcmp(header.m_magic, INDEX_MAGIC, 8) || header.m_file_size != m_file_size || !header.m_interval ||
+        header.m_mtime != m_mtime || header.m_fingerprint != m_fingerprint)
+      return false;
+
+    std::vector<uint64_t> offsets(header.m_num_offsets), records(header.m_num_offsets);
+    if (!in.read((char*)offsets.data(), offsets.size() * sizeof(uint64_t))) return false;
+    if (!in.read((char*)records.data(), records.size() * sizeof(uint64_t))) return false;
+    m_interval = header.m_interval;
+    m_offsets.swap(offsets);
+    m_index_records.swap(records);
+    return true;
+  }
+
+  void write_index() {
+    m_index_written = true;
+    std::ofstream out(m_filename + ".idx", std::ios::binary);
+    index_header_s header;
+    memcpy(header.m_magic, INDEX_MAGIC, 8);
+    header.m_interval = m_interval;
+    header.m_file_size = m_file_size;
+    header.m_mtime = m_mtime;
+    header.m_fingerprint = m_fingerprint;
+    header.m_num_lines = m_line;
+    header.m_num_offsets = m_offsets.size();
+    out.write((const char*)&header, sizeof(header));
+    out.write((const char*)m_offsets.data(), m_offsets.size() * sizeof(uint64_t));
+    out.write((const char*)m_index_records.data(), m_index_records.size() * sizeof(uint64_t));
+    out.close();
+    if (out.fail()) std::cerr << "cannot write the trace index " << m_filename << ".idx\n";
+  }
+
+  std::string m_filename;
+  std::ifstream m_file;
+  std::string m_text;                ///< the last line read
+  bool m_is_open;
+  bool m_stream;                     ///< stdin, a FIFO or a ring: read once, no index
+  bool m_parallel;                   ///< records come from m_parser
+  trace_parser_c m_parser;
+  bool m_from_ring;                  ///< records come from m_ring
+  shm_ring_c m_ring;
+  bool m_adapted;                    ///< records come from m_adapter
+  trace_adapter_c m_adapter;
+  uint64_t m_file_size;
+  uint64_t m_mtime;                  ///< modification time of the trace (ns), for the index file
+  uint64_t m_fingerprint;            ///< fingerprint() of the trace, for the index file
+  counter m_line;                    ///< number of the next line
+  uint64_t m_offset;                 ///< byte offset of the next line
+  counter m_record;                  ///< records in the lines read
+  int m_run_type;                    ///< the last line read (a collapsed run: m_run_left records of it are left)
+  addr_t m_run_addr;
+  uint32_t m_run_size;
+  uint32_t m_run_left;
+
+  counter m_interval;                ///< lines between index entries
+  std::vector<uint64_t> m_offsets;   ///< byte offset of line ii * m_interval
+  std::vector<uint64_t> m_index_records;  ///< records before line ii * m_interval
+  bool m_use_index_file;
+  bool m_index_written;              ///< the sidecar is up to date (loaded or written)
+};
+
+#endif // !__TRACE_READER_H__
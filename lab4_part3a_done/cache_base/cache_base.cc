@@ -12,6 +12,7 @@
 #include "atom/mem_req.h"
 
 #include <cmath>
+#include <cstring>
 #include <string>
 #include <cassert>
 #include <fstream>
@@ -48,7 +49,7 @@ void cache_set_c::update_access_order(int entry_no) {
 }
 
 //true if dirty is evicted
-void cache_set_c::evict_and_bring_new(int tag, bool set_dirty, bool& evicted, bool& dirty_evicted, int& evicted_tag) {
+void cache_set_c::evict_and_bring_new(addr_t tag, bool set_dirty, bool& evicted, bool& dirty_evicted, addr_t& evicted_tag) {
   //when writing to cache, first find if there are any invalid (vacant) blocks
   int i;
   evicted = true; //return whether it is evicted
@@ -84,8 +85,6 @@ int cache_set_c::get_lra_entry() {
  * @param num_sets - number of sets in a cache
  * @param assoc - number of cache entries in a set
  * @param line_size - cache block (line) size in bytes
- *
- * @note You do not have to modify this (other than for debugging purposes).
  */
 cache_base_c::cache_base_c(std::string name, int num_sets, int assoc, int line_size) {
   m_name = name;
@@ -101,6 +100,14 @@ cache_base_c::cache_base_c(std::string name, int num_sets, int assoc, int line_s
     for (int jj = 0; jj < assoc; ++jj) {
       m_set[ii]->m_entry[jj].m_valid = false;
       m_set[ii]->m_entry[jj].m_dirty = false;
+      m_set[ii]->m_entry[jj].m_prefetch = false;
+      m_set[ii]->m_entry[jj].m_owner = 0;
+      m_set[ii]->m_entry[jj].m_shared = false;
+      m_set[ii]->m_entry[jj].m_coh_inval = false;
+      m_set[ii]->m_entry[jj].m_sharers = 0;
+      m_set[ii]->m_entry[jj].m_presence = 0;
+      m_set[ii]->m_entry[jj].m_fill_land = 0;
+      m_set[ii]->m_entry[jj].m_excl = false;
       m_set[ii]->m_entry[jj].m_tag   = 0;
     }
   }
@@ -119,8 +126,8 @@ cache_base_c::~cache_base_c() {
   delete[] m_set;
 }
 
-bool cache_base_c::evict_and_bring_new(int set_idx, int tag, int req_type, bool set_dirty) {
-  bool evicted, dirty_evicted; int evicted_tag;
+bool cache_base_c::evict_and_bring_new(int set_idx, addr_t tag, int req_type, bool set_dirty) {
+  bool evicted, dirty_evicted; addr_t evicted_tag;
   m_set[set_idx]->evict_and_bring_new(tag, set_dirty, evicted, dirty_evicted, evicted_tag);
   return dirty_evicted;
 }
@@ -143,7 +150,7 @@ bool cache_base_c::access(addr_t address, int access_type, bool is_fill) {
 
   bool res = false;
   int set_idx = (address / this->m_line_size) % this->m_num_sets;
-  int tag = address / this->m_line_size / this->m_num_sets;
+  addr_t tag = address / this->m_line_size / this->m_num_sets;
 
   //std::cout << address << " is accessed  at " << m_name << ", currently need_writeback is " << (need_writeback ? "true" : "false") << " and it is " << (is_fill ? "" : "not ") << "a fill inst." << std::endl;
   
@@ -232,11 +239,41 @@ bool cache_base_c::access(addr_t address, int access_type, bool is_fill) {
   return res;
 }
 
+/**
+ * This is one reference of a write-allocate cache (Part I), repeated for a
+ * run of same-line, same-type references (see atom/trace_collapser.h): a
+ * lookup, and on a miss the line is brought in as MRU (dirty for a write).
+ * @param repeat - number of references in the run
+ * @return true if the first reference hit
+ */
+bool cache_base_c::access_run(addr_t address, int access_type, int repeat) {
+  bool hit = access(address, access_type, false);
+  if (!hit) {
+    int set_idx = (address / this->m_line_size) % this->m_num_sets;
+    addr_t tag = address / this->m_line_size / this->m_num_sets;
+    if (evict_and_bring_new(set_idx, tag, access_type, access_type == WRITE)) m_num_writebacks++;
+  }
+  if (repeat > 1) repeat_hits(access_type, repeat - 1);
+  return hit;
+}
+
+/**
+ * After an access, the line is in the cache at the MRU position (and dirty
+ * after a write), so more accesses of the same type to it all hit and leave
+ * the LRU order and the tag store as they are: only the statistics change.
+ * This is exact for LRU.
+ */
+void cache_base_c::repeat_hits(int access_type, int count) {
+  m_num_accesses += count;
+  m_num_hits += count;
+  if (access_type == WRITE) m_num_writes += count;
+}
+
 //only used for l1 cache!!
 //return if invalidated data is dirty
 bool cache_base_c::invalidate(addr_t address) {
   int set_idx = (address / this->m_line_size) % this->m_num_sets;
-  int tag = address / this->m_line_size / this->m_num_sets;
+  addr_t tag = address / this->m_line_size / this->m_num_sets;
   for (int i = 0; i < m_set[set_idx]->m_assoc; i++) {
   if (m_set[set_idx]->m_entry[i].m_valid && m_set[set_idx]->m_entry[i].m_tag == tag) {
     //if found, invalidate.
@@ -248,6 +285,80 @@ bool cache_base_c::invalidate(addr_t address) {
 return false;
 }
 
+/**
+ * This looks up the tag store without updating the LRU state or statistics.
+ * @param address - memory address
+ * @param return the valid entry holding the line; nullptr if not present.
+ */
+cache_entry_c* cache_base_c::find_entry(addr_t address) {
+  int set_idx = (address / this->m_line_size) % this->m_num_sets;
+  addr_t tag = address / this->m_line_size / this->m_num_sets;
+  for (int i = 0; i < m_set[set_idx]->m_assoc; i++) {
+    if (m_set[set_idx]->m_entry[i].m_valid && m_set[set_idx]->m_entry[i].m_tag == tag)
+      return &m_set[set_idx]->m_entry[i];
+  }
+  return nullptr;
+}
+
+bool cache_base_c::probe(addr_t address) {
+  return find_entry(address) != nullptr;
+}
+
+/**
+ * This adds the (line-aligned) address of every valid line to a set.
+ */
+void cache_base_c::get_lines(std::unordered_set<addr_t>& lines) {
+  for (int set_idx = 0; set_idx < m_num_sets; ++set_idx) {
+    for (int i = 0; i < m_set[set_idx]->m_assoc; i++) {
+      cache_entry_c& entry = m_set[set_idx]->m_entry[i];
+      if (entry.m_valid) lines.insert((entry.m_tag * m_num_sets + set_idx) * m_line_size);
+    }
+  }
+}
+
+/**
+ * This writes the geometry of the cache and then the entries and the LRU
+ * order of every set, as they are in memory, so that loading them back is a
+ * copy per set.
+ */
+void cache_base_c::save_state(std::ostream& out) {
+  int assoc = m_set[0]->m_assoc;
+  uint32_t geometry[3] = {(uint32_t)m_num_sets, (uint32_t)assoc, (uint32_t)m_line_size};
+  out.write((const char*)geometry, sizeof(geometry));
+  for (int ii = 0; ii < m_num_sets; ++ii) {
+    out.write((const char*)m_set[ii]->m_entry, assoc * sizeof(cache_entry_c));
+    out.write((const char*)m_set[ii]->access_order, assoc * sizeof(int));
+  }
+}
+
+const char* cache_base_c::load_state(const char* data, const char* end) {
+  int assoc = m_set[0]->m_assoc;
+  uint32_t geometry[3];
+  size_t set_size = assoc * (sizeof(cache_entry_c) + sizeof(int));
+  if (end - data < (long)(sizeof(geometry) + m_num_sets * set_size)) return nullptr;
+
+  memcpy(geometry, data, sizeof(geometry));
+  if (geometry[0] != (uint32_t)m_num_sets || geometry[1] != (uint32_t)assoc || geometry[2] != (uint32_t)m_line_size)
+    return nullptr;
+  data += sizeof(geometry);
+
+  for (int ii = 0; ii < m_num_sets; ++ii) {
+    memcpy(m_set[ii]->m_entry, data, assoc * sizeof(cache_entry_c));
+    data += assoc * sizeof(cache_entry_c);
+    memcpy(m_set[ii]->access_order, data, assoc * sizeof(int));
+    data += assoc * sizeof(int);
+  }
+  return data;
+}
+
+void cache_base_c::reset_stats() {
+  m_num_accesses = 0;
+  m_num_hits = 0;
+  m_num_misses = 0;
+  m_num_writes = 0;
+  m_num_writebacks = 0;
+}
+
 /**
  * Print statistics (DO NOT CHANGE)
  */
@@ -5,8 +5,10 @@
 #define __CACHE_BASE_H__
 
 #include <cstdint>
+#include <ostream>
 #include <string>
 #include <list>
+#include <unordered_set>
 
 typedef enum request_type_enum {
   READ = 0,
@@ -23,6 +25,14 @@ public:
   cache_entry_c() {} ;
   bool   m_valid;    // valid bit for the cacheline
   bool   m_dirty;    // dirty bit 
+  bool   m_prefetch; // brought in by a prefetch and not referenced yet
+  int    m_owner;    // core whose request brought the line in
+  bool   m_shared;   // MESI (L1): other L1s may hold the line (S); clean and not shared is E
+  bool   m_coh_inval;// MESI (L1): invalidated by another core's write; the tag is kept
+  uint64_t m_sharers;// directory (L2): bit c set if core c's L1 may hold the line
+  uint64_t m_presence;// L2: bit k set if upper-level cache k holds the line
+  uint64_t m_fill_land;// L2: cycle the last fill sent up is installed in the upper level
+  bool   m_excl;     // directory (L2): the only sharer holds the line in E or M
   addr_t m_tag;      // tag for the line
   friend class cache_base_c;
 };
@@ -33,7 +43,7 @@ class cache_set_c
 public:
     cache_set_c(int assoc);
     void update_access_order(int entry_no);
-    void evict_and_bring_new(int tag, bool set_dirty, bool& evicted, bool& dirty_evicted, int& evicted_tag);
+    void evict_and_bring_new(addr_t tag, bool set_dirty, bool& evicted, bool& dirty_evicted, addr_t& evicted_tag);
     int get_lra_entry();
     ~cache_set_c();
 
@@ -53,12 +63,25 @@ class cache_base_c
 public:
   cache_base_c();
   cache_base_c(std::string name, int num_set, int assoc, int line_size);
-  ~cache_base_c();
+  virtual ~cache_base_c();
 
   bool access(addr_t address, int access_type, bool is_fill);
+  bool access_run(addr_t address, int access_type, int repeat);  // lookup, allocate on a miss, then repeat-1 hits
+  void repeat_hits(int access_type, int count);  // count more accesses to the line just accessed (MRU)
   void print_stats();
+  void reset_stats();
+  void save_state(std::ostream& out);                   // tag store and LRU order, in binary (checkpoint)
+  const char* load_state(const char* data, const char* end);  // from save_state(); nullptr if it does not fit
   void dump_tag_store(bool is_file);  // false: dump to stdout, true: dump to a file
   bool invalidate(addr_t address);
+  bool probe(addr_t address);         // true if the line is present (no state/stat update)
+  int  get_num_accesses() const { return m_num_accesses; }
+  int  get_num_hits() const { return m_num_hits; }
+  int  get_num_misses() const { return m_num_misses; }
+  int  get_num_writebacks() const { return m_num_writebacks; }
+  void get_lines(std::unordered_set<addr_t>& lines);  // add the address of every valid line
+  int  get_num_lines() const { return m_num_sets * m_set[0]->m_assoc; }
+  const std::string& get_name() const { return m_name; }
 
 private:
 
@@ -70,7 +93,8 @@ private:
   int m_num_writebacks;
 
 protected:
-  virtual bool evict_and_bring_new(int set_id, int tag, int req_type, bool set_dirty);
+  cache_entry_c* find_entry(addr_t address);  // valid entry holding the line, or nullptr
+  virtual bool evict_and_bring_new(int set_id, addr_t tag, int req_type, bool set_dirty);
   bool need_writeback = false; //need writeback?
   bool evict_dirty = 0;
    cache_set_c **m_set;    // cache data structure
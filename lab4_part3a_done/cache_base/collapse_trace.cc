@@ -0,0 +1,50 @@
+// ECE 430.322: Computer Organization
+// Lab 4: Memory System Simulation
+
+#include "atom/trace_collapser.h"
+#include "atom/trace_reader.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+/**
+ * This writes a trace with each run of same-line, same-type records
+ * collapsed into one "<type> <hex address> <repeat>" record (the repeat is
+ * left out when it is 1). run_base and memory_sim read the result like any
+ * trace; run_base gives the same results from it, faster.
+ */
+int main(int argc, char** argv) {
+  if (argc != 3 && argc != 4) {
+    fprintf(stderr, "[Usage]: %s <trace> <line size (in bytes)> [<output trace>]\n", argv[0]);
+    return -1;
+  }
+
+  trace_reader_c trace;
+  if (!trace.open(argv[1])) {
+    fprintf(stderr, "cannot open %s\n", argv[1]);
+    return -1;
+  }
+  FILE* out = (argc == 4) ? fopen(argv[3], "w") : stdout;
+  if (!out) {
+    fprintf(stderr, "cannot open %s\n", argv[3]);
+    return -1;
+  }
+
+  trace_collapser_c runs(trace, atoi(argv[2]));
+  int type;
+  addr_t address;
+  uint32_t repeat;
+  counter num_runs = 0;
+  while (runs.next(type, address, repeat)) {
+    if (repeat == 1) {
+      fprintf(out, "%d %lx\n", type, address);
+    } else {
+      fprintf(out, "%d %lx %u\n", type, address, repeat);
+    }
+    num_runs++;
+  }
+
+  fprintf(stderr, "%llu records -> %llu lines\n", (unsigned long long)trace.tell(), (unsigned long long)num_runs);
+  if (out != stdout) fclose(out);
+  return 0;
+}
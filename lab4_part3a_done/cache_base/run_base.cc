@@ -2,37 +2,45 @@
 // Lab 4: Memory System Simulation
 
 #include "cache_base.h"
+#include "atom/trace_collapser.h"
+#include "atom/trace_reader.h"
 
 #include <cstdio>
+#include <cstdlib>
 #include <iostream>
-#include <fstream>
 #include <string>
 
 /**
- * This function opens a trace file and feeds the trace to your cache
+ * This function opens a trace file and feeds the trace to your cache. Runs
+ * of same-line, same-type records go to the cache as one access with a
+ * repeat count, which gives the same results for LRU.
  * @param cache - cache instance to process the trace 
  * @param name - trace file name
+ * @param line_size - cache line size (for the runs)
+ * @param first - first record to process
+ * @param index - records between the entries of the "<trace>.idx" index file
+ *                that finds it (0: no index file)
  */
-void process_trace(cache_base_c* cache, const char* name) {
-  std::ifstream trace_file(name);
-  std::string line;
+void process_trace(cache_base_c* cache, const char* name, int line_size, counter first, counter index) {
+  trace_reader_c trace;
 
   int type;
   addr_t address;
+  uint32_t repeat;
 
-  if (trace_file.is_open()) {
-    while (std::getline(trace_file, line)) {
-      std::sscanf(line.c_str(), "%d %lx", &type, &address);
-        cache->access(address, type, 1);
+  if (trace.open(name, index, index > 0) && trace.seek(first)) {
+    trace_collapser_c runs(trace, line_size);
+    while (runs.next(type, address, repeat)) {
+        cache->access_run(address, type, repeat);
     }
   }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 int main(int argc, char** argv) {
-  if (argc != 5) {
+  if (argc < 5 || argc > 7) {
     fprintf(stderr, "[Usage]: %s <trace> <cache size (in bytes)> <associativity> "
-                    "<line size (in bytes)> \n", argv[0]);
+                    "<line size (in bytes)> [<first record> [<index interval>]]\n", argv[0]);
     return -1;
   }
   
@@ -43,7 +51,8 @@ int main(int argc, char** argv) {
     int num_sets = atoi(argv[2]) / atoi(argv[3]) / atoi(argv[4]); // example
   cache_base_c* cc = new cache_base_c("L1", num_sets, atoi(argv[3]), atoi(argv[4]));
 
-  process_trace(cc, argv[1]);
+  process_trace(cc, argv[1], atoi(argv[4]), argc >= 6 ? strtoull(argv[5], nullptr, 10) : 0,
+                argc == 7 ? strtoull(argv[6], nullptr, 10) : 0);
   cc->print_stats();
   //cc->dump_tag_store(false);
   delete cc;
@@ -0,0 +1,101 @@
+// ECE 430.322: Computer Organization
+// Lab 4: Memory System Simulation
+
+#include "checkpoint.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char CHECKPOINT_MAGIC[8] = {'L', 'A', 'B', '4', 'C', 'K', 'P', 'T'};
+static const uint32_t CHECKPOINT_VERSION = 2;
+
+/**
+ * [Checkpoint Format]
+ * header_s, one trace_reader_c::pos_s per core (which keeps a position
+ * within a collapsed line), then the state of every cache in the order of
+ * memory_hierarchy_c::get_caches() (see cache_c::save_state()).
+ */
+struct header_s {
+  char     m_magic[8];
+  uint32_t m_version;
+  uint32_t m_entry_size;       ///< sizeof(cache_entry_c) of the simulator that wrote it
+  uint32_t m_num_cores;
+  uint32_t m_num_caches;
+};
+
+bool checkpoint_c::save(const std::string& filename, memory_hierarchy_c* mm, std::vector<core_c*>& cores) {
+  if (mm->get_num_in_flight_reqs() != 0 || !mm->is_wb_done()) {
+    std::cerr << "checkpoint: the memory hierarchy is not idle\n";
+    return false;
+  }
+
+  std::ofstream out(filename, std::ios::binary);
+  if (!out) return false;
+
+  std::vector<cache_c*> caches = mm->get_caches();
+  header_s header;
+  memcpy(header.m_magic, CHECKPOINT_MAGIC, sizeof(header.m_magic));
+  header.m_version = CHECKPOINT_VERSION;
+  header.m_entry_size = sizeof(cache_entry_c);
+  header.m_num_cores = cores.size();
+  header.m_num_caches = caches.size();
+  out.write((const char*)&header, sizeof(header));
+
+  for (auto core : cores) {
+    trace_reader_c::pos_s pos = core->get_trace_pos();
+    out.write((const char*)&pos, sizeof(pos));
+  }
+
+  for (auto cache : caches) cache->save_state(out);
+  return out.good();
+}
+
+bool checkpoint_c::load(const std::string& filename, memory_hierarchy_c* mm, std::vector<core_c*>& cores) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(header_s)) {
+    close(fd);
+    return false;
+  }
+  size_t size = st.st_size;
+  void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return false;
+
+  const char* data = (const char*)map;
+  const char* end = data + size;
+  std::vector<cache_c*> caches = mm->get_caches();
+
+  header_s header;
+  memcpy(&header, data, sizeof(header));
+  data += sizeof(header);
+  bool ok = !memcmp(header.m_magic, CHECKPOINT_MAGIC, sizeof(header.m_magic)) &&
+            header.m_version == CHECKPOINT_VERSION &&
+            header.m_entry_size == sizeof(cache_entry_c) &&
+            header.m_num_cores == cores.size() &&
+            header.m_num_caches == caches.size() &&
+            end - data >= (long)(cores.size() * sizeof(trace_reader_c::pos_s));
+
+  for (unsigned ii = 0; ok && ii < cores.size(); ++ii) {
+    trace_reader_c::pos_s pos;
+    memcpy(&pos, data, sizeof(pos));
+    data += sizeof(pos);
+    ok = cores[ii]->set_trace_pos(pos);
+  }
+
+  for (unsigned ii = 0; ok && ii < caches.size(); ++ii) {
+    data = caches[ii]->load_state(data, end);
+    ok = (data != nullptr);
+  }
+
+  munmap(map, size);
+  return ok;
+}
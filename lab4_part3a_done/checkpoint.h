@@ -0,0 +1,31 @@
+// ECE 430.322: Computer Organization
+// Lab 4: Memory System Simulation
+
+#ifndef __CHECKPOINT_H__
+#define __CHECKPOINT_H__
+
+#include "memory_system/memory_hierarchy.h"
+#include "core/core.h"
+
+#include <string>
+#include <vector>
+
+/***
+ *
+ * @class checkpoint (checkpoint_c)
+ *
+ * This saves the warmed state of a simulation (the contents of every cache
+ * and the position of every core in its trace) to a binary file, and loads
+ * it back through mmap. A checkpoint is taken on an idle hierarchy, e.g.,
+ * right after a fast-forward, so no request is in flight. It can be loaded
+ * by any configuration with the same caches (number, sizes and order) and
+ * number of cores; latencies, policies, the core model and main memory may
+ * differ.
+ */
+class checkpoint_c {
+public:
+  static bool save(const std::string& filename, memory_hierarchy_c* mm, std::vector<core_c*>& cores);
+  static bool load(const std::string& filename, memory_hierarchy_c* mm, std::vector<core_c*>& cores);
+};
+
+#endif // !__CHECKPOINT_H__
@@ -2,6 +2,7 @@
 
 #include <fstream>
 #include <cassert>
+#include <cstdlib>
 #include <vector>
 
 config_c::config_c(const std::string& fname) {
@@ -31,6 +32,8 @@ void config_c::parse(const std::string& fname) {
       line = line.substr(end);
     }
 
+    if (tokens.empty()) continue;
+
     if (tokens[0] == "mem_hierarchy") {
       mem_hierarchy = atoi(tokens[1].c_str());
     } else if (tokens[0] == "l1i_size") {
@@ -61,7 +64,152 @@ void config_c::parse(const std::string& fname) {
       memory_latency = atoi(tokens[1].c_str());
     } else if (tokens[0] == "single_request") {
       single_request = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "memory_model") {
+      memory_model = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "dram_channels") {
+      dram_channels = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "dram_ranks") {
+      dram_ranks = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "dram_banks") {
+      dram_banks = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "dram_row_size") {
+      dram_row_size = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "dram_addr_map") {
+      dram_addr_map = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "dram_page_policy") {
+      dram_page_policy = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "dram_tRCD") {
+      dram_tRCD = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "dram_tCAS") {
+      dram_tCAS = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "dram_tRP") {
+      dram_tRP = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "dram_tBURST") {
+      dram_tBURST = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "dram_wq_high") {
+      dram_wq_high = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "dram_wq_low") {
+      dram_wq_low = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "dram_queue_size") {
+      dram_queue_size = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "l1_prefetcher") {
+      l1_prefetcher = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "l1_prefetch_degree") {
+      l1_prefetch_degree = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "l2_prefetcher") {
+      l2_prefetcher = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "l2_prefetch_degree") {
+      l2_prefetch_degree = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "ifetch_prefetcher") {
+      ifetch_prefetcher = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "ifetch_prefetch_depth") {
+      ifetch_prefetch_depth = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "l2_ports") {
+      l2_ports = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "parallel_sim") {
+      parallel_sim = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "sim_quantum") {
+      sim_quantum = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "coherence") {
+      coherence = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "l2_inclusion") {
+      l2_inclusion = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "l1_split") {
+      l1_split = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "victim_cache_size") {
+      victim_cache_size = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "victim_cache_latency") {
+      victim_cache_latency = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "core_model") {
+      core_model = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "issue_width") {
+      issue_width = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "rob_size") {
+      rob_size = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "lsq_size") {
+      lsq_size = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "fast_forward") {
+      fast_forward = strtoull(tokens[1].c_str(), nullptr, 10);
+    } else if (tokens[0] == "sample_period") {
+      sample_period = strtoull(tokens[1].c_str(), nullptr, 10);
+    } else if (tokens[0] == "sample_warmup") {
+      sample_warmup = strtoull(tokens[1].c_str(), nullptr, 10);
+    } else if (tokens[0] == "sample_size") {
+      sample_size = strtoull(tokens[1].c_str(), nullptr, 10);
+    } else if (tokens[0] == "trace_index") {
+      trace_index = strtoull(tokens[1].c_str(), nullptr, 10);
+    } else if (tokens[0] == "trace_skip") {
+      trace_skip = strtoull(tokens[1].c_str(), nullptr, 10);
+    } else if (tokens[0] == "trace_threads") {
+      trace_threads = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "checkpoint_load") {
+      checkpoint_load = tokens[1];
+    } else if (tokens[0] == "checkpoint_save") {
+      checkpoint_save = tokens[1];
+    } else if (tokens[0] == "l1_filter_record") {
+      l1_filter_record = tokens[1];
+    } else if (tokens[0] == "latency_grid") {
+      latency_grid = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "grid_l1d_latency" || tokens[0] == "grid_l2_latency" || tokens[0] == "grid_memory_latency") {
+      std::vector<int>& grid = (tokens[0] == "grid_l1d_latency") ? grid_l1d_latency :
+                               (tokens[0] == "grid_l2_latency") ? grid_l2_latency : grid_memory_latency;
+      grid.clear();
+      for (size_t ii = 1; ii < tokens.size(); ++ii) {
+        grid.push_back(atoi(tokens[ii].c_str()));
+      }
+    } else if (tokens[0] == "grid_validate") {
+      grid_validate = atoi(tokens[1].c_str());
+    } else if (tokens[0] == "cache_level") {
+      assert(tokens.size() >= 8 && "cache_level = <name> <size> <assoc> <line size> <latency> <inclusion> <private|shared>");
+      cache_level_s level;
+      level.m_name      = tokens[1];
+      level.m_size      = atoi(tokens[2].c_str());
+      level.m_assoc     = atoi(tokens[3].c_str());
+      level.m_line_size = atoi(tokens[4].c_str());
+      level.m_latency   = atoi(tokens[5].c_str());
+      level.m_inclusion = atoi(tokens[6].c_str());
+      level.m_shared    = (tokens[7] == "shared");
+      level.m_prefetcher      = (tokens.size() > 8) ? atoi(tokens[8].c_str()) : 0;
+      level.m_prefetch_degree = (tokens.size() > 9) ? atoi(tokens[9].c_str()) : 2;
+      cache_levels.push_back(level);
     }
   }
   file.close();
+
+  // mem_hierarchy 1: private L1 only, 2: private L1 + shared L2 (see Hierarchy)
+  if (cache_levels.empty()) {
+    if (mem_hierarchy >= 1) {
+      cache_levels.push_back(cache_level_s{"L1", l1d_size, l1d_assoc, l1d_line_size, l1d_latency,
+                                           0, false, l1_prefetcher, l1_prefetch_degree});
+    }
+    if (mem_hierarchy == 2) {
+      cache_levels.push_back(cache_level_s{"L2", l2_size, l2_assoc, l2_line_size, l2_latency,
+                                           l2_inclusion, true, l2_prefetcher, l2_prefetch_degree});
+    }
+  }
+}
+
+/**
+ * The hierarchy below the L1s, for replaying a trace of their misses and
+ * write-backs (l1_filter_c): the top level goes away with the L1I, its
+ * victim cache and the instruction prefetcher, which all shaped that trace.
+ */
+void config_c::filter_l1() {
+  if (!cache_levels.empty()) cache_levels.erase(cache_levels.begin());
+  l1_split = 0;
+  victim_cache_size = 0;
+  ifetch_prefetcher = 0;
+  l1_filtered = true;
+}
+
+/**
+ * This changes the latency of the first two cache levels (whether they come
+ * from cache_level lines or from the l1d/l2 settings) and of main memory.
+ */
+void config_c::set_latencies(int l1d, int l2, int memory) {
+  l1d_latency = l1d;
+  l2_latency = l2;
+  memory_latency = memory;
+  if (cache_levels.size() > 0) cache_levels[0].m_latency = l1d;
+  if (cache_levels.size() > 1) cache_levels[1].m_latency = l2;
 }
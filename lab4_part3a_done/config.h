@@ -1,7 +1,27 @@
 #ifndef __CONFIG_H__
 #define __CONFIG_H__
 
+#include <cstdint>
 #include <string>
+#include <vector>
+
+/**
+ * One level of the cache hierarchy, from a line
+ *   cache_level = <name> <size> <assoc> <line size> <latency> <inclusion> <private|shared> [<prefetcher> <degree>]
+ * Levels are listed from the top (L1) down; the inclusion policy is towards
+ * the level above. A private level has one cache per core.
+ */
+struct cache_level_s {
+  std::string m_name;
+  int  m_size;
+  int  m_assoc;
+  int  m_line_size;
+  int  m_latency;
+  int  m_inclusion;        ///< INCLUSION_POLICY
+  bool m_shared;           ///< one cache for all the cores
+  int  m_prefetcher;       ///< PREFETCHER_TYPE
+  int  m_prefetch_degree;
+};
 
 class config_c {
 public:
@@ -9,6 +29,8 @@ public:
   config_c(const std::string& fname);
 
   void parse(const std::string& fname);
+  void filter_l1();          ///< drop the top level (and everything behind the L1s) to replay an L1-filtered trace
+  void set_latencies(int l1d, int l2, int memory);  ///< of the first two levels and main memory
 
   int get_mem_hierarchy() const {return mem_hierarchy;}
   int is_single_request() const {return single_request;}
@@ -29,6 +51,60 @@ public:
 
   int get_memory_latency() const {return memory_latency;} 
 
+  int get_memory_model() const {return memory_model;}
+  int get_dram_channels() const {return dram_channels;}
+  int get_dram_ranks() const {return dram_ranks;}
+  int get_dram_banks() const {return dram_banks;}
+  int get_dram_row_size() const {return dram_row_size;}
+  int get_dram_addr_map() const {return dram_addr_map;}
+  int get_dram_page_policy() const {return dram_page_policy;}
+  int get_dram_tRCD() const {return dram_tRCD;}
+  int get_dram_tCAS() const {return dram_tCAS;}
+  int get_dram_tRP() const {return dram_tRP;}
+  int get_dram_tBURST() const {return dram_tBURST;}
+  int get_dram_wq_high() const {return dram_wq_high;}
+  int get_dram_wq_low() const {return dram_wq_low;}
+  int get_dram_queue_size() const {return dram_queue_size;}
+
+  int get_l1_prefetcher() const {return l1_prefetcher;}
+  int get_l1_prefetch_degree() const {return l1_prefetch_degree;}
+  int get_l2_prefetcher() const {return l2_prefetcher;}
+  int get_l2_prefetch_degree() const {return l2_prefetch_degree;}
+  int get_ifetch_prefetcher() const {return ifetch_prefetcher;}
+  int get_ifetch_prefetch_depth() const {return ifetch_prefetch_depth;}
+
+  int get_l2_ports() const {return l2_ports;}
+  int get_parallel_sim() const {return parallel_sim;}
+  int get_sim_quantum() const {return sim_quantum;}
+  int get_coherence() const {return coherence;}
+  int get_l2_inclusion() const {return l2_inclusion;}
+  int get_l1_split() const {return l1_split;}
+  int get_victim_cache_size() const {return victim_cache_size;}
+  int get_victim_cache_latency() const {return victim_cache_latency;}
+  int get_core_model() const {return core_model;}
+  int get_issue_width() const {return issue_width;}
+  int get_rob_size() const {return rob_size;}
+  int get_lsq_size() const {return lsq_size;}
+  uint64_t get_fast_forward() const {return fast_forward;}
+  uint64_t get_sample_period() const {return sample_period;}
+  uint64_t get_sample_warmup() const {return sample_warmup;}
+  uint64_t get_sample_size() const {return sample_size;}
+  uint64_t get_trace_index() const {return trace_index;}
+  uint64_t get_trace_skip() const {return trace_skip;}
+  int get_trace_threads() const {return trace_threads;}
+  const std::string& get_checkpoint_load() const {return checkpoint_load;}
+  const std::string& get_checkpoint_save() const {return checkpoint_save;}
+  const std::string& get_l1_filter_record() const {return l1_filter_record;}
+  bool is_l1_filtered() const {return l1_filtered;}
+  int get_latency_grid() const {return latency_grid;}
+  const std::vector<int>& get_grid_l1d_latency() const {return grid_l1d_latency;}
+  const std::vector<int>& get_grid_l2_latency() const {return grid_l2_latency;}
+  const std::vector<int>& get_grid_memory_latency() const {return grid_memory_latency;}
+  int get_grid_validate() const {return grid_validate;}
+
+  /// the cache levels from the top down; without cache_level lines, they follow mem_hierarchy and the l1d/l2 settings
+  const std::vector<cache_level_s>& get_cache_levels() const {return cache_levels;}
+
 private:
   int mem_hierarchy;
   int single_request;
@@ -49,6 +125,59 @@ private:
   int l2_latency;
 
   int memory_latency;
+
+  int memory_model = 0;
+  int dram_channels = 1;
+  int dram_ranks = 1;
+  int dram_banks = 8;
+  int dram_row_size = 2048;
+  int dram_addr_map = 0;
+  int dram_page_policy = 0;
+  int dram_tRCD = 14;
+  int dram_tCAS = 14;
+  int dram_tRP = 14;
+  int dram_tBURST = 4;
+  int dram_wq_high = 32;
+  int dram_wq_low = 16;
+  int dram_queue_size = 64;
+
+  int l1_prefetcher = 0;
+  int l1_prefetch_degree = 2;
+  int l2_prefetcher = 0;
+  int l2_prefetch_degree = 2;
+  int ifetch_prefetcher = 0;
+  int ifetch_prefetch_depth = 4;
+
+  int l2_ports = 1;
+  int parallel_sim = 0;
+  int sim_quantum = 0;
+  int coherence = 0;
+  int l2_inclusion = 0;
+  int l1_split = 0;
+  int victim_cache_size = 0;
+  int victim_cache_latency = 1;
+  int core_model = 0;
+  int issue_width = 4;
+  int rob_size = 128;
+  int lsq_size = 32;
+  uint64_t fast_forward = 0;
+  uint64_t sample_period = 0;
+  uint64_t sample_warmup = 2000;
+  uint64_t sample_size = 1000;
+  uint64_t trace_index = 0;
+  uint64_t trace_skip = 0;
+  int trace_threads = 1;
+  std::string checkpoint_load;
+  std::string checkpoint_save;
+  std::string l1_filter_record;
+  bool l1_filtered = false;
+  int latency_grid = 0;
+  std::vector<int> grid_l1d_latency;
+  std::vector<int> grid_l2_latency;
+  std::vector<int> grid_memory_latency;
+  int grid_validate = 0;
+
+  std::vector<cache_level_s> cache_levels;
 };
 
 #endif // !__CONFIG_H__
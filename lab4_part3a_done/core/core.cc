@@ -2,74 +2,326 @@
 // Lab 4: Memory System Simulation
 
 #include "core.h"
+#include "ooo_core.h"
+#include "sampler.h"
 #include "memory_system/memory_hierarchy.h"
 
-#include <fstream>
+#include <cassert>
 #include <iostream>
+#include <limits>
 
 // constructor
-core_c::core_c(memory_hierarchy_c* mm) {
+core_c::core_c(memory_hierarchy_c* mm, int core_id) {
   m_mm = mm;
+  m_core_id = core_id;
   m_cycle = 0;
 
   m_num_insts = 0;
   m_num_mem_insts = 0;
+  m_num_ff_records = 0;
+  m_num_skipped = 0;
+  m_record_limit = std::numeric_limits<counter>::max();
+
+  m_trace_done = false;
+  m_trace_eof = false;
+  m_done = false;
+  m_has_next = false;
 }
 
 // destructor
 core_c::~core_c() {
 }
 
+/**
+ * This creates a core of the model selected by core_model in the config.
+ */
+core_c* core_c::create(memory_hierarchy_c* mm, int core_id) {
+  if (mm->m_config.get_core_model() == CORE_OOO) return new ooo_core_c(mm, core_id);
+  return new core_c(mm, core_id);
+}
+
 /**
  * This runs simulation with a given trace file
- * @param filename - name of the trace file
+ * @param filename - name of the trace file (unless a trace is open already)
  */
 void core_c::run_sim(std::string filename) {
-  std::ifstream trace_file(filename);
-
-  if (!trace_file.is_open()) 
+  if (!m_trace.is_open() && !open_trace(filename))
     return; 
 
-  std::string line;
-  addr_t address;
-  int type;
+  if (m_mm->m_config.get_sample_period()) {
+    run_sampled();
+    return;
+  }
 
+  run_to_end();
+  print_stats();
+}
+
+void core_c::run_to_end() {
   while (true) {
-    if (!m_mm->m_config.is_single_request() || m_mm->get_num_in_flight_reqs() == 0) {
-      std::getline(trace_file, line);
-      if (trace_file.eof()) break;
-
-      std::sscanf(line.c_str(), "%d %lx", &type,  &address);
-
-      if (type == REQ_IFETCH) {
-        m_mm->access(address, type);
-        m_num_insts++;
-        
-        int process_granularity = 1000;
-        if (m_num_insts % process_granularity == 0) {
-          std::cout <<"Processed " << m_num_insts << " instructions\n";
-        }
-
-      } else if (type == REQ_DFETCH || type == REQ_DSTORE) {
-        m_mm->access(address, type);
-        m_num_mem_insts++;
-      }
-    }
+    fetch();
+    if (m_trace_done) break;
     run_a_cycle();
   }
 
   // keep running until all in-flight requests and write-backs are committed
+  drain();
+}
+
+/**
+ * [Sampled Simulation]
+ *
+ * The trace is cut into periods of sample_period records. In each period,
+ * the records are first run through the caches functionally (see
+ * fast_forward()); the last sample_warmup + sample_size records are then
+ * simulated in detail on the warmed hierarchy, and the last sample_size of
+ * them are measured until their requests return. CPI and the hit rate of
+ * each cache are computed per measurement window and reported with their
+ * confidence intervals. The whole-run statistics of the caches include the
+ * functional accesses; the core's cycles only cover the detailed records.
+ */
+void core_c::run_sampled() {
+  counter period = m_mm->m_config.get_sample_period();
+  counter warmup = m_mm->m_config.get_sample_warmup();
+  counter size   = m_mm->m_config.get_sample_size();
+  assert(size > 0 && warmup + size <= period);
+
+  std::vector<cache_c*> caches = m_mm->get_caches();
+  std::vector<counter> accesses(caches.size()), hits(caches.size());
+  sampler_c sampler;
+
+  while (!m_trace_eof) {
+    m_mm->begin_fast_forward();
+    fast_forward(period - warmup - size);
+    m_mm->end_fast_forward(false);
+
+    run_records(warmup);
+
+    counter cycle = m_cycle;
+    counter num_insts = m_num_insts;
+    for (unsigned ii = 0; ii < caches.size(); ++ii) {
+      accesses[ii] = caches[ii]->get_num_accesses();
+      hits[ii] = caches[ii]->get_num_hits();
+    }
+
+    // a window cut short by the end of the trace is not a sample
+    counter num_read = run_records(size);
+    drain();
+    if (num_read < size || m_num_insts == num_insts) continue;
+
+    sampler.add("CPI", (double)(m_cycle - cycle) / (m_num_insts - num_insts));
+    for (unsigned ii = 0; ii < caches.size(); ++ii) {
+      counter num_accesses = caches[ii]->get_num_accesses() - accesses[ii];
+      if (!num_accesses) continue;
+      sampler.add(caches[ii]->get_name() + " Hit Rate (%)",
+                  (double)(caches[ii]->get_num_hits() - hits[ii]) / num_accesses * 100);
+    }
+  }
+
+  print_stats();
+  sampler.print_stats();
+}
+
+counter core_c::run_records(counter num_records) {
+  counter start = m_trace.tell();
+  m_record_limit = start + num_records;
+  resume();
+
+  while (true) {
+    fetch();
+    if (m_trace_done) break;
+    run_a_cycle();
+  }
+
+  m_record_limit = std::numeric_limits<counter>::max();
+  return m_trace.tell() - start;
+}
+
+void core_c::drain() {
   while (m_mm->get_num_in_flight_reqs() != 0 || !m_mm->is_wb_done()) {
     run_a_cycle();
   }
- 
+}
+
+void core_c::resume() {
+  if (!m_trace_eof) m_trace_done = false;
+}
+
+/**
+ * This opens the trace file the core executes.
+ * @param filename - name of the trace file
+ */
+bool core_c::open_trace(const std::string& filename) {
+  counter interval = m_mm->m_config.get_trace_index();
+  return m_trace.open(filename, interval, interval != 0, m_mm->m_config.get_trace_threads());
+}
+
+/**
+ * This reads the next trace record and sends it to the memory hierarchy. In
+ * single-request mode, the core waits until its previous request returns.
+ * With a split L1, the data access of an instruction goes to the L1D port in
+ * the same cycle as its fetch goes to the L1I.
+ */
+void core_c::fetch() {
+  if (m_trace_done) return;
+
+  if (m_mm->m_config.is_single_request() && m_mm->get_num_in_flight_reqs(m_core_id) != 0) return;
+
+  addr_t address;
+  int type;
+  uint32_t size;
+
+  if (m_has_next) {
+    type = m_next_type;
+    address = m_next_addr;
+    size = m_next_size;
+    m_has_next = false;
+  } else if (!read_record(type, address, size)) {
+    m_trace_done = true;
+    return;
+  }
+  issue(type, address, size);
+
+  if (type != REQ_IFETCH || !m_mm->is_l1_split()) return;
+
+  if (!read_record(m_next_type, m_next_addr, m_next_size)) {
+    m_trace_done = true;
+    return;
+  }
+  m_has_next = true;
+  if (m_next_type == REQ_DFETCH || m_next_type == REQ_DSTORE) {
+    issue(m_next_type, m_next_addr, m_next_size);
+    m_has_next = false;
+  }
+}
+
+/**
+ * This runs the next records through the caches functionally, without
+ * time (see memory_hierarchy_c::begin_fast_forward()).
+ * @return the number of records read (less at the end of the trace)
+ */
+counter core_c::fast_forward(counter num_records) {
+  int type;
+  addr_t address;
+  uint32_t size;
+  counter num_read = 0;
+  while (num_read < num_records && read_record(type, address, size)) {
+    if (type == REQ_IFETCH || type == REQ_DFETCH || type == REQ_DSTORE) {
+      m_mm->warm(address, type, m_core_id);
+    }
+    num_read++;
+  }
+  m_num_ff_records += num_read;
+  return num_read;
+}
+
+/**
+ * [Latency Grid]
+ *
+ * This runs the rest of the trace through the caches functionally, like
+ * fast_forward(), and counts the requests by the level that served them:
+ * served[k] for level k + 1, the last entry for main memory. Records that
+ * send no request go to num_other. The instructions count as executed.
+ */
+void core_c::profile(std::vector<counter>& served, counter& num_other) {
+  int type;
+  addr_t address;
+  uint32_t size;
+  while (read_record(type, address, size)) {
+    if (type == REQ_IFETCH || type == REQ_DFETCH || type == REQ_DSTORE) {
+      served[m_mm->warm(address, type, m_core_id) - 1]++;
+      if (type == REQ_IFETCH) m_num_insts++;
+      else m_num_mem_insts++;
+    } else {
+      num_other++;
+    }
+  }
+}
+
+/**
+ * This moves to a position saved by get_trace_pos(), which may be within a
+ * collapsed line. The records before it count as fast-forwarded.
+ */
+bool core_c::set_trace_pos(const trace_reader_c::pos_s& pos) {
+  if (!m_trace.seek(pos)) return false;
+  m_num_ff_records += m_trace.tell();
+  return true;
+}
+
+/**
+ * This moves to a later record (through the trace index) without running
+ * the records before it.
+ */
+bool core_c::skip_records(counter num_records) {
+  counter start = m_trace.tell();
+  if (!m_trace.seek(start + num_records)) return false;
+  m_num_skipped += num_records;
+  return true;
+}
+
+/**
+ * This reads the next record. A collapsed line (a run of same-line accesses
+ * with a repeat count) is one record per access, and the record limit can
+ * stop in the middle of it.
+ */
+bool core_c::read_record(int& type, addr_t& address, uint32_t& size) {
+  if (m_trace.tell() == m_record_limit) return false;
+
+  if (!m_trace.next(type, address, size)) {
+    m_trace_eof = true;
+    return false;
+  }
+  return true;
+}
+
+void core_c::issue(int type, addr_t address, uint32_t size) {
+  if (type == REQ_IFETCH) {
+    m_mm->access(address, type, m_core_id, nullptr, size);
+    count_inst();
+  } else if (type == REQ_DFETCH || type == REQ_DSTORE) {
+    m_mm->access(address, type, m_core_id, nullptr, size);
+    m_num_mem_insts++;
+  }
+}
+
+void core_c::count_inst() {
+  m_num_insts++;
+    
+  int process_granularity = 1000;
+  if (m_num_insts % process_granularity == 0) {
+    std::cout <<"Processed " << m_num_insts << " instructions\n";
+  }
+}
+
+/**
+ * In multi-core mode, the memory hierarchy is ticked once for all cores. A
+ * core counts cycles until its trace is finished and its requests returned.
+ */
+void core_c::tick() {
+  if (m_done) return;
+
+  m_cycle++;
+  if (m_trace_done && m_mm->get_num_in_flight_reqs(m_core_id) == 0) m_done = true;
+}
+
+void core_c::print_stats() {
   std::cout << "------------------------------" << std::endl;
-  std::cout << "Performance Stats" << std::endl;
+  if (m_mm->get_num_cores() == 1) {
+    std::cout << "Performance Stats" << std::endl;
+  } else {
+    std::cout << "Core " << m_core_id << " Performance Stats" << std::endl;
+  }
   std::cout << "------------------------------" << std::endl;
   std::cout << "CPI:  " << ((float) m_cycle / m_num_insts) << std::endl;
   std::cout << "number of cycles: " << m_cycle << std::endl;
   std::cout << "number of insts: " << m_num_insts << std::endl;
   std::cout << "number of memory insts: " << m_num_mem_insts << std::endl;
+  if (m_num_skipped) {
+    std::cout << "number of skipped records: " << m_num_skipped << std::endl;
+  }
+  if (m_num_ff_records) {
+    std::cout << "number of fast-forwarded records: " << m_num_ff_records << std::endl;
+  }
 }
 
 void core_c::run_a_cycle() {
@@ -5,24 +5,77 @@
 #define __CORE_H__
 
 #include "memory_system/memory_hierarchy.h"
+#include "atom/trace_reader.h"
 #include <string>
+#include <vector>
 
+enum CORE_MODEL {
+  CORE_IN_ORDER = 0,   ///< one trace record per cycle (single_request: one request at a time)
+  CORE_OOO             ///< multi-issue out-of-order window (ooo_core_c)
+};
+
+/***
+ *
+ * @class core (core_c)
+ *
+ * This reads a trace and sends one record to the memory hierarchy per cycle.
+ * Every count of records here (fast-forward, skip, record limit, trace
+ * position) is in trace_reader_c records: one per access, so a collapsed
+ * line with a repeat count of n is n records.
+ */
 class core_c {
 public:
-  core_c(memory_hierarchy_c* mm);
-  ~core_c();
+  core_c(memory_hierarchy_c* mm, int core_id = 0);
+  virtual ~core_c();
+
+  static core_c* create(memory_hierarchy_c* mm, int core_id);  ///< core of the configured CORE_MODEL
 
   void run_sim(std::string filename);
+  void run_sampled();                            ///< periodic sampling (see config sample_period)
+
+  bool open_trace(const std::string& filename);  ///< attach a trace (multi-core mode)
+  counter fast_forward(counter num_records);     ///< warm the caches with the next records (functional)
+  void profile(std::vector<counter>& served, counter& num_other);  ///< the rest of the trace, functionally (latency grid)
+  void run_to_end();                             ///< timed simulation of the rest of the trace, without stats
+  trace_reader_c::pos_s get_trace_pos() const { return m_trace.tell_pos(); }  ///< position in the trace (checkpoint)
+  bool set_trace_pos(const trace_reader_c::pos_s& pos);
+  bool skip_records(counter num_records);        ///< start later in the trace (no warm-up)
+  virtual void fetch();                          ///< issue the next trace record, if allowed
+  virtual void resume();                         ///< fetch again after a record limit was reached
+  void tick();                                   ///< count a cycle (multi-core mode)
+  bool is_done() { return m_done; }              ///< trace finished and all requests returned
+  virtual void print_stats();
 
 private:
   void run_a_cycle();
+  void issue(int type, addr_t address, uint32_t size);  ///< send a record to the memory hierarchy
+  counter run_records(counter num_records);      ///< timed simulation of the next records
+  void drain();                                  ///< run until nothing is in flight
+
+protected:
+  bool read_record(int& type, addr_t& address, uint32_t& size);  ///< next trace record (false at the end)
+  void count_inst();                             ///< one more instruction fetched
 
 public:
   memory_hierarchy_c* m_mm;
+  int m_core_id;
   counter m_cycle;
 
   counter m_num_insts;         // # instructions (this includes #mem insts)
   counter m_num_mem_insts;     // # memory instructions 
+  counter m_num_ff_records;    // # records fast-forwarded
+  counter m_num_skipped;       // # records skipped
+  counter m_record_limit;      // read_record() stops at this record number
+
+protected:
+  trace_reader_c m_trace;
+  bool m_trace_done;           // reached the end of the trace (or the record limit)
+  bool m_trace_eof;            // reached the end of the trace
+  bool m_done;                 // m_trace_done and no request in flight
+  bool m_has_next;             // a record was read ahead (split L1)
+  int m_next_type;             // type of the record read ahead
+  addr_t m_next_addr;          // address of the record read ahead
+  uint32_t m_next_size;        // size of the record read ahead
 };
 
 #endif // !__CORE_H__
@@ -0,0 +1,264 @@
+// ECE 430.322: Computer Organization
+// Lab 4: Memory System Simulation
+
+#include "ooo_core.h"
+
+#include <cassert>
+#include <functional>
+#include <iostream>
+
+ooo_core_c::ooo_core_c(memory_hierarchy_c* mm, int core_id) : core_c(mm, core_id) {
+  m_issue_width = mm->m_config.get_issue_width();
+  m_rob_size    = mm->m_config.get_rob_size();
+  m_lsq_size    = mm->m_config.get_lsq_size();
+  assert(m_issue_width > 0 && m_rob_size > 0 && m_lsq_size > 0);
+
+  m_ifetch_hit_latency = mm->get_hit_latency(REQ_IFETCH);
+  m_data_hit_latency   = mm->get_hit_latency(REQ_DFETCH);
+  m_fetch_line_size    = mm->get_line_size(REQ_IFETCH);
+
+  m_rob_head = 0;
+  m_lsq_used = 0;
+  m_has_next_inst = false;
+  m_trace_end = false;
+  m_ifetch_miss = false;
+  m_fetch_line = (addr_t)-1;
+  m_fetch_id = 0;
+  m_fetch_in_flight = false;
+
+  m_rob_full_cycles = 0;
+  m_lsq_full_cycles = 0;
+  m_ifetch_stall_cycles = 0;
+  m_miss_cycles = 0;
+  m_outstanding_misses = 0;
+
+  mm->set_core_batch_done_func(core_id, std::bind(&ooo_core_c::requests_done, this,
+                                                  std::placeholders::_1, std::placeholders::_2));
+}
+
+/**
+ * One core cycle. The requests that returned in the previous cycle let
+ * instructions retire and data accesses go out first, and then new
+ * instructions enter the window.
+ */
+void ooo_core_c::fetch() {
+  if (m_trace_done) return;
+
+  sample_misses();
+  retire();
+  issue_mem_ops();
+  dispatch();
+
+  if (m_trace_end && m_rob.empty()) m_trace_done = true;
+}
+
+/**
+ * The window is empty when the core stops at a record limit. The line
+ * fetched last is fetched again, since the caches may have changed since.
+ */
+void ooo_core_c::resume() {
+  core_c::resume();
+  if (m_trace_done) return;
+  m_trace_end = false;
+  m_fetch_line = (addr_t)-1;
+}
+
+/**
+ * This reads an IFETCH record and the data records that follow it.
+ */
+bool ooo_core_c::read_inst(inst_s& inst) {
+  inst.m_has_ifetch = false;
+  inst.m_ifetch_done = false;
+  inst.m_mem_ops.clear();
+
+  int type;
+  addr_t address;
+  uint32_t size;
+  while (true) {
+    if (m_has_next) {
+      type = m_next_type;
+      address = m_next_addr;
+      size = m_next_size;
+      m_has_next = false;
+    } else if (!read_record(type, address, size)) {
+      return inst.m_has_ifetch || !inst.m_mem_ops.empty();
+    }
+
+    if (type == REQ_IFETCH) {
+      if (inst.m_has_ifetch || !inst.m_mem_ops.empty()) {
+        // the next instruction starts here
+        m_has_next = true;
+        m_next_type = type;
+        m_next_addr = address;
+        m_next_size = size;
+        return true;
+      }
+      inst.m_has_ifetch = true;
+      inst.m_ifetch_addr = address;
+    } else if (type == REQ_DFETCH || type == REQ_DSTORE) {
+      inst.m_mem_ops.push_back(mem_op_s{type, address, size, false, false});
+    }
+  }
+}
+
+void ooo_core_c::retire() {
+  for (int ii = 0; ii < m_issue_width && !m_rob.empty(); ++ii) {
+    inst_s& inst = m_rob.front();
+    if (!inst.m_ifetch_done) return;
+    for (auto& op : inst.m_mem_ops) {
+      if (op.m_type == REQ_DSTORE ? !op.m_issued : !op.m_done) return;
+    }
+
+    // a store keeps its LSQ entry until the write completes
+    for (auto& op : inst.m_mem_ops) {
+      if (op.m_type != REQ_DSTORE) m_lsq_used--;
+    }
+    m_rob.pop_front();
+    m_rob_head++;
+  }
+}
+
+/**
+ * The ready memory operations of a cycle are sent as one batch.
+ */
+void ooo_core_c::issue_mem_ops() {
+  m_batch.clear();
+  m_batch_ops.clear();
+  counter seq = m_rob_head;
+  for (auto it = m_rob.begin(); it != m_rob.end() && (int)m_batch.size() < m_issue_width; ++it, ++seq) {
+    if (!it->m_ifetch_done) continue;
+
+    for (int op = 0; op < (int)it->m_mem_ops.size() && (int)m_batch.size() < m_issue_width; ++op) {
+      mem_op_s& mem_op = it->m_mem_ops[op];
+      if (mem_op.m_issued) continue;
+
+      m_batch.push_back(mem_access_s{mem_op.m_addr, mem_op.m_type, mem_op.m_size});
+      m_batch_ops.push_back(in_flight_s{seq, seq, op, mem_op.m_type, m_cycle});
+      mem_op.m_issued = true;
+    }
+  }
+  if (m_batch.empty()) return;
+
+  m_batch_ids.resize(m_batch.size());
+  int sent = m_mm->access_batch(m_batch.data(), m_batch.size(), m_core_id, m_batch_ids.data());
+  for (int ii = 0; ii < sent; ++ii) {
+    m_in_flight[m_batch_ids[ii]] = m_batch_ops[ii];
+  }
+  // the L1 was full: the rest are issued again in a later cycle
+  for (int ii = sent; ii < (int)m_batch.size(); ++ii) {
+    m_rob[m_batch_ops[ii].m_seq - m_rob_head].m_mem_ops[m_batch_ops[ii].m_op].m_issued = false;
+  }
+}
+
+void ooo_core_c::dispatch() {
+  for (int ii = 0; ii < m_issue_width; ++ii) {
+    if (m_ifetch_miss) {
+      m_ifetch_stall_cycles++;
+      return;
+    }
+    if (!m_has_next_inst) {
+      if (!read_inst(m_next_inst)) {
+        m_trace_end = true;
+        return;
+      }
+      m_has_next_inst = true;
+    }
+
+    if ((int)m_rob.size() == m_rob_size) {
+      m_rob_full_cycles++;
+      return;
+    }
+    int num_ops = m_next_inst.m_mem_ops.size();
+    if (m_lsq_used > 0 && m_lsq_used + num_ops > m_lsq_size) {
+      m_lsq_full_cycles++;
+      return;
+    }
+
+    counter seq = m_rob_head + m_rob.size();
+    m_rob.push_back(m_next_inst);
+    m_has_next_inst = false;
+    m_lsq_used += num_ops;
+    m_num_mem_insts += num_ops;
+
+    inst_s& inst = m_rob.back();
+    if (!inst.m_has_ifetch) {
+      inst.m_ifetch_done = true;
+      continue;
+    }
+    count_inst();
+
+    // the next instruction in the line that was fetched last needs no new request
+    addr_t line = inst.m_ifetch_addr / m_fetch_line_size;
+    if (line == m_fetch_line) {
+      if (m_fetch_in_flight) {
+        m_in_flight[m_fetch_id].m_seq_last = seq;
+      } else {
+        inst.m_ifetch_done = true;
+      }
+      continue;
+    }
+
+    m_mm->access(inst.m_ifetch_addr, REQ_IFETCH, m_core_id, &m_fetch_id);
+    m_in_flight[m_fetch_id] = in_flight_s{seq, seq, -1, REQ_IFETCH, m_cycle};
+    m_fetch_line = line;
+    m_fetch_in_flight = true;
+  }
+}
+
+void ooo_core_c::requests_done(mem_req_s* const* reqs, int num) {
+  for (int ii = 0; ii < num; ++ii) {
+    request_done(reqs[ii]);
+  }
+}
+
+void ooo_core_c::request_done(mem_req_s* req) {
+  auto it = m_in_flight.find(req->m_id);
+  assert(it != m_in_flight.end());
+  in_flight_s info = it->second;
+  m_in_flight.erase(it);
+
+  if (info.m_type == REQ_DSTORE) m_lsq_used--;
+
+  if (info.m_op == -1) {
+    for (counter seq = info.m_seq; seq <= info.m_seq_last; ++seq) {
+      m_rob[seq - m_rob_head].m_ifetch_done = true;
+    }
+    if (req->m_id == m_fetch_id) m_fetch_in_flight = false;
+    return;
+  }
+
+  // a store may have retired already
+  if (info.m_seq < m_rob_head) return;
+  m_rob[info.m_seq - m_rob_head].m_mem_ops[info.m_op].m_done = true;
+}
+
+/**
+ * A request still in flight after the L1 hit latency is an outstanding miss.
+ * MLP is the average number of outstanding misses over the cycles with at
+ * least one.
+ */
+void ooo_core_c::sample_misses() {
+  int num_misses = 0;
+  m_ifetch_miss = false;
+  for (auto& it : m_in_flight) {
+    bool is_ifetch = (it.second.m_type == REQ_IFETCH);
+    counter hit_latency = is_ifetch ? m_ifetch_hit_latency : m_data_hit_latency;
+    if (m_cycle - it.second.m_issue_cycle <= hit_latency) continue;
+
+    num_misses++;
+    if (is_ifetch) m_ifetch_miss = true;
+  }
+
+  m_outstanding_misses += num_misses;
+  if (num_misses) m_miss_cycles++;
+}
+
+void ooo_core_c::print_stats() {
+  core_c::print_stats();
+  std::cout << "average outstanding misses: " << (double)m_outstanding_misses/m_cycle << "\n";
+  std::cout << "MLP (outstanding misses while any is outstanding): "
+            << (m_miss_cycles ? (double)m_outstanding_misses/m_miss_cycles : 0) << "\n";
+  std::cout << "ROB full stall cycles: " << m_rob_full_cycles << "\n";
+  std::cout << "LSQ full stall cycles: " << m_lsq_full_cycles << "\n";
+  std::cout << "instruction fetch miss stall cycles: " << m_ifetch_stall_cycles << "\n";
+}
@@ -0,0 +1,98 @@
+// ECE 430.322: Computer Organization
+// Lab 4: Memory System Simulation
+
+#ifndef __OOO_CORE_H__
+#define __OOO_CORE_H__
+
+#include "core.h"
+
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+/***
+ *
+ * @class out-of-order core (ooo_core_c)
+ *
+ * This models the memory side of a multi-issue out-of-order core. Every
+ * cycle, up to issue_width instructions (an IFETCH record and the data
+ * records that follow it) enter the ROB in order while the ROB and the
+ * load/store queue have room, and their instruction fetches are sent. The
+ * data accesses of an instruction are sent once its fetch has returned, so
+ * independent loads and stores overlap across the whole window. Instructions
+ * retire in order, up to issue_width per cycle, once their fetch and loads
+ * have returned; a store retires once it is sent and keeps its LSQ entry
+ * until the write completes. The front end fetches a line once for all the
+ * consecutive instructions in it, and an instruction fetch slower than an
+ * L1 hit stops the front end until it returns.
+ */
+class ooo_core_c : public core_c {
+public:
+  ooo_core_c(memory_hierarchy_c* mm, int core_id = 0);
+
+  void fetch() override;        ///< one core cycle: retire, send memory operations, dispatch
+  void resume() override;
+  void print_stats() override;
+
+private:
+  struct mem_op_s {
+    int     m_type;             ///< REQ_DFETCH or REQ_DSTORE
+    addr_t  m_addr;
+    uint32_t m_size;
+    bool    m_issued;           ///< sent to the memory hierarchy
+    bool    m_done;             ///< returned
+  };
+
+  struct inst_s {
+    bool    m_has_ifetch;       ///< false for data records before the first IFETCH
+    addr_t  m_ifetch_addr;
+    bool    m_ifetch_done;
+    std::vector<mem_op_s> m_mem_ops;
+  };
+
+  struct in_flight_s {
+    counter m_seq;              ///< instruction (ROB sequence number)
+    counter m_seq_last;         ///< last instruction served (a fetched line serves several)
+    int     m_op;               ///< index in m_mem_ops (-1: instruction fetch)
+    int     m_type;
+    counter m_issue_cycle;
+  };
+
+  bool read_inst(inst_s& inst);       ///< next instruction and its data records (false at the end)
+  void retire();                      ///< in order, up to issue_width
+  void issue_mem_ops();               ///< oldest first, up to issue_width
+  void dispatch();                    ///< in order, up to issue_width
+  void requests_done(mem_req_s* const* reqs, int num);  ///< callback from the memory hierarchy
+  void request_done(mem_req_s* req);
+  void sample_misses();               ///< MLP and front-end stall accounting
+
+  int m_issue_width;
+  int m_rob_size;
+  int m_lsq_size;
+  int m_ifetch_hit_latency;           ///< an instruction fetch slower than this missed the L1
+  int m_data_hit_latency;             ///< a data access slower than this missed the L1
+  int m_fetch_line_size;              ///< instruction fetch granularity
+
+  std::deque<inst_s> m_rob;
+  counter m_rob_head;                 ///< sequence number of m_rob.front()
+  int m_lsq_used;                     ///< loads in the ROB + stores not yet written
+  std::unordered_map<uint32_t, in_flight_s> m_in_flight;  ///< request id -> what it is for
+  std::vector<mem_access_s> m_batch;  ///< memory operations sent this cycle
+  std::vector<in_flight_s> m_batch_ops;
+  std::vector<uint32_t> m_batch_ids;
+  bool m_has_next_inst;               ///< m_next_inst was read but did not fit yet
+  inst_s m_next_inst;
+  bool m_trace_end;                   ///< no more instructions to dispatch
+  bool m_ifetch_miss;                 ///< an instruction fetch missed the L1 (front end stalled)
+  addr_t m_fetch_line;                ///< line of the last instruction fetch
+  uint32_t m_fetch_id;                ///< its request id
+  bool m_fetch_in_flight;             ///< the request for m_fetch_line has not returned
+
+  counter m_rob_full_cycles;          ///< # cycles dispatch stopped on a full ROB
+  counter m_lsq_full_cycles;          ///< # cycles dispatch stopped on a full LSQ
+  counter m_ifetch_stall_cycles;      ///< # cycles dispatch stopped on an instruction fetch miss
+  counter m_miss_cycles;              ///< # cycles with at least one outstanding miss
+  counter m_outstanding_misses;       ///< outstanding misses summed over the cycles
+};
+
+#endif // !__OOO_CORE_H__
@@ -0,0 +1,57 @@
+// ECE 430.322: Computer Organization
+// Lab 4: Memory System Simulation
+
+#include "sampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+void sampler_c::add(const std::string& metric, double value) {
+  for (auto& m : m_metrics) {
+    if (m.m_name != metric) continue;
+    m.m_num++;
+    m.m_sum += value;
+    m.m_sum_sq += value * value;
+    return;
+  }
+  m_metrics.push_back(metric_s{metric, 1, value, value * value});
+}
+
+/**
+ * Two-sided 95% Student-t value for df degrees of freedom; past the table,
+ * that of the next smaller tabled df (a slightly wider interval).
+ */
+static double t_value(counter df) {
+  static const double table[30] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+     2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+     2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+  if (df <= 30) return table[df - 1];
+  if (df < 40) return 2.042;
+  if (df < 60) return 2.021;
+  if (df < 120) return 2.000;
+  return 1.980;
+}
+
+/**
+ * The half-width of the interval is also given relative to the mean. It is
+ * 0 with a single sample (no variance estimate).
+ */
+void sampler_c::print_stats() {
+  std::cout << "------------------------------" << "\n";
+  std::cout << "Sampling Stats (95 % confidence)" << "\n";
+  std::cout << "------------------------------" << "\n";
+  for (auto& m : m_metrics) {
+    double mean = m.m_sum / m.m_num;
+    double var = 0;
+    double half = 0;
+    if (m.m_num > 1) {
+      var = std::max(0.0, (m.m_sum_sq - m.m_num * mean * mean) / (m.m_num - 1));
+      half = t_value(m.m_num - 1) * std::sqrt(var / m.m_num);
+    }
+
+    std::cout << m.m_name << ": " << mean << " +- " << half
+              << " (" << (mean ? half / mean * 100 : 0) << " %, " << m.m_num << " samples)\n";
+  }
+}
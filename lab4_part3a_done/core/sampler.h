@@ -0,0 +1,38 @@
+// ECE 430.322: Computer Organization
+// Lab 4: Memory System Simulation
+
+#ifndef __SAMPLER_H__
+#define __SAMPLER_H__
+
+#include "atom/global.h"
+
+#include <string>
+#include <vector>
+
+/***
+ *
+ * @class sampler (sampler_c)
+ *
+ * This collects one value of each metric (e.g., CPI, hit rate) per
+ * measurement window of a sampled simulation and reports their mean with a
+ * 95% confidence interval (mean +- t * stddev / sqrt(n), where t is the
+ * Student-t value for n - 1 degrees of freedom: 12.7 for two samples, 2.09
+ * for 20, close to the normal 1.96 from about 100 on).
+ */
+class sampler_c {
+public:
+  void add(const std::string& metric, double value);  ///< one sample of a metric
+  void print_stats();
+
+private:
+  struct metric_s {
+    std::string m_name;
+    counter m_num;              ///< # samples
+    double  m_sum;
+    double  m_sum_sq;           ///< sum of the squares
+  };
+
+  std::vector<metric_s> m_metrics;  ///< in the order they were first added
+};
+
+#endif // !__SAMPLER_H__
@@ -0,0 +1,42 @@
+// $ g++ -std=c++11 -o shm_producer shm_producer.cc -pthread -lrt
+// $ ./shm_producer lab4 100000 & ../memory_sim shm:lab4 ../configs/memory.cfg
+
+#include "../atom/shm_ring.h"
+#include "../atom/mem_req.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+// a tracer in the same host pushes records into the ring instead of writing a trace file.
+// this one "traces" a loop that copies an array: b[i] = a[i] + 1
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    fprintf(stderr, "[Usage]: %s <ring name> <iterations>\n", argv[0]);
+    return -1;
+  }
+
+  // the simulator (trace "shm:<ring name>") attaches to the ring once it exists.
+  shm_ring_c ring;
+  if (!ring.create(argv[1])) {
+    fprintf(stderr, "cannot create ring %s\n", argv[1]);
+    return -1;
+  }
+
+  const addr_t code = 0x400000;
+  const addr_t a = 0x10000000;
+  const addr_t b = 0x20000000;
+  long iterations = atol(argv[2]);
+  for (long ii = 0; ii < iterations; ++ii) {
+    // 4 instructions per iteration: load, add, store, branch
+    ring.push(REQ_IFETCH, code, 4);
+    ring.push(REQ_DFETCH, a + ii * 4, 4);
+    ring.push(REQ_IFETCH, code + 4, 4);
+    ring.push(REQ_IFETCH, code + 8, 4);
+    ring.push(REQ_DSTORE, b + ii * 4, 4);
+    ring.push(REQ_IFETCH, code + 12, 4);
+  }
+
+  // the simulator stops once it has read every record pushed before finish()
+  ring.finish();
+  return 0;
+}
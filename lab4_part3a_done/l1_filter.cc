@@ -0,0 +1,169 @@
+// ECE 430.322: Computer Organization
+// Lab 4: Memory System Simulation
+
+#include "l1_filter.h"
+
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char L1_FILTER_MAGIC[8] = {'L', 'A', 'B', '4', 'L', '1', 'F', 'T'};
+static const uint32_t L1_FILTER_VERSION = 1;
+
+/**
+ * [L1 Filter Format]
+ * filter_header_s, then one filter_record_s per request that left an L1, in
+ * the order they left. The header is written again with the totals once the
+ * run is over.
+ */
+struct filter_header_s {
+  char     m_magic[8];
+  uint32_t m_version;
+  uint32_t m_record_size;      ///< sizeof(filter_record_s) of the simulator that wrote it
+  uint64_t m_num_records;
+  uint64_t m_num_cycles;       ///< cycles of the recorded run
+  uint64_t m_num_insts;        ///< instructions of the recorded run
+};
+
+enum RECORD_FLAG {
+  FLAG_PREFETCH  = 1,          ///< an L1 prefetch (not a demand miss)
+  FLAG_DIRTY     = 2,          ///< a write-back of a dirty line
+  FLAG_TO_MEMORY = 4           ///< a write-back straight to main memory (back-invalidation)
+};
+
+struct filter_record_s {
+  uint64_t m_cycle;            ///< cycle the request left the L1
+  uint64_t m_num_insts;        ///< instructions read by the core by then
+  uint64_t m_addr;
+  uint32_t m_size;
+  uint16_t m_type;             ///< MEM_REQ_TYPE
+  uint16_t m_flags;            ///< RECORD_FLAG
+};
+
+bool l1_filter_c::record(const std::string& filename, memory_hierarchy_c* mm, core_c* core) {
+  if (mm->get_num_cores() != 1 || mm->get_caches().empty()) {
+    std::cerr << "l1 filter: needs a single core and at least one cache level\n";
+    return false;
+  }
+
+  m_out.open(filename, std::ios::binary);
+  if (!m_out) return false;
+
+  filter_header_s header;
+  memset(&header, 0, sizeof(header));
+  m_out.write((const char*)&header, sizeof(header));
+
+  m_mm = mm;
+  m_core = core;
+  m_num_records = 0;
+  mm->set_l1_out_func([this](mem_req_s* req, bool to_memory) { write(req, to_memory); });
+  return m_out.good();
+}
+
+void l1_filter_c::write(mem_req_s* req, bool to_memory) {
+  filter_record_s record;
+  record.m_cycle = m_mm->get_cycle();
+  record.m_num_insts = m_core->m_num_insts;
+  record.m_addr = req->m_addr;
+  record.m_size = req->m_size;
+  record.m_type = req->m_type;
+  record.m_flags = (req->m_pf_level ? FLAG_PREFETCH : 0) | (req->m_dirty ? FLAG_DIRTY : 0) |
+                   (to_memory ? FLAG_TO_MEMORY : 0);
+  m_out.write((const char*)&record, sizeof(record));
+  m_num_records++;
+}
+
+bool l1_filter_c::finish(core_c* core) {
+  m_mm->set_l1_out_func(nullptr);
+
+  filter_header_s header;
+  memcpy(header.m_magic, L1_FILTER_MAGIC, sizeof(header.m_magic));
+  header.m_version = L1_FILTER_VERSION;
+  header.m_record_size = sizeof(filter_record_s);
+  header.m_num_records = m_num_records;
+  header.m_num_cycles = core->m_cycle;
+  header.m_num_insts = core->m_num_insts;
+  m_out.seekp(0);
+  m_out.write((const char*)&header, sizeof(header));
+  m_out.close();
+  return !m_out.fail();
+}
+
+/**
+ * This replays an L1-filtered trace on the hierarchy below the L1s of a
+ * configuration: every record is sent at its cycle (see
+ * memory_hierarchy_c::access_below_l1()), and the hierarchy then runs until
+ * all the requests and write-backs are done.
+ */
+bool l1_filter_c::replay(const std::string& filename, config_c& config) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(filter_header_s)) {
+    close(fd);
+    return false;
+  }
+  size_t size = st.st_size;
+  void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return false;
+
+  filter_header_s header;
+  memcpy(&header, map, sizeof(header));
+  const filter_record_s* records = (const filter_record_s*)((const char*)map + sizeof(header));
+  if (memcmp(header.m_magic, L1_FILTER_MAGIC, sizeof(header.m_magic)) ||
+      header.m_version != L1_FILTER_VERSION || header.m_record_size != sizeof(filter_record_s) ||
+      (size - sizeof(header)) / sizeof(filter_record_s) < header.m_num_records) {
+    munmap(map, size);
+    return false;
+  }
+
+  config_c below = config;
+  below.filter_l1();
+  std::string error = memory_hierarchy_c::check(below, 1);
+  if (!error.empty()) {
+    std::cerr << "l1 filter: " << error << "\n";
+    munmap(map, size);
+    return false;
+  }
+  memory_hierarchy_c* mm = new memory_hierarchy_c(below, 1);
+
+  // latency below the L1 of the demand misses
+  counter num_misses = 0, miss_cycles = 0;
+  mm->set_core_done_func(0, [&](mem_req_s* req) {
+    if (req->m_pf_level) return;
+    num_misses++;
+    miss_cycles += mm->get_cycle() - req->m_in_cycle;
+  });
+
+  uint64_t next = 0;
+  while (next < header.m_num_records || mm->get_num_in_flight_reqs() != 0 || !mm->is_wb_done()) {
+    for (; next < header.m_num_records && records[next].m_cycle <= mm->get_cycle(); ++next) {
+      const filter_record_s& record = records[next];
+      mm->access_below_l1(record.m_addr, record.m_type, record.m_size, (record.m_flags & FLAG_PREFETCH) ? 1 : 0,
+                          record.m_flags & FLAG_DIRTY, record.m_flags & FLAG_TO_MEMORY);
+    }
+    mm->run_a_cycle();
+  }
+
+  std::cout << "------------------------------" << std::endl;
+  std::cout << "L1 Filter Replay Stats" << std::endl;
+  std::cout << "------------------------------" << std::endl;
+  std::cout << "number of records: " << header.m_num_records << std::endl;
+  std::cout << "records per 1000 insts: "
+            << (header.m_num_insts ? (double)header.m_num_records * 1000 / header.m_num_insts : 0) << std::endl;
+  std::cout << "number of recorded cycles: " << header.m_num_cycles << std::endl;
+  std::cout << "number of recorded insts: " << header.m_num_insts << std::endl;
+  std::cout << "number of replayed cycles: " << mm->get_cycle() << std::endl;
+  std::cout << "average latency below the L1: " << (num_misses ? (double)miss_cycles / num_misses : 0) << std::endl;
+  mm->print_stats();
+
+  delete mm;
+  munmap(map, size);
+  return true;
+}
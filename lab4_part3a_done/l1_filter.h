@@ -0,0 +1,52 @@
+// ECE 430.322: Computer Organization
+// Lab 4: Memory System Simulation
+
+#ifndef __L1_FILTER_H__
+#define __L1_FILTER_H__
+
+#include "memory_system/memory_hierarchy.h"
+#include "core/core.h"
+#include "config.h"
+
+#include <fstream>
+#include <string>
+
+/***
+ *
+ * @class L1 filter (l1_filter_c)
+ *
+ * A sweep of the L2 and main memory settings keeps the L1s as they are, so
+ * the L1s see the same trace and send the same requests below them in every
+ * run. This records those requests once: record() hooks the L1s of a single
+ * core run, and every miss, prefetch and write-back that leaves an L1 goes to
+ * a binary file with the cycle it left and the number of instructions the
+ * core had read by then. replay() then runs that file, a fraction of the
+ * trace (its L1 miss rate), straight into the levels below the L1 of any
+ * configuration with the same L1s (config_c::filter_l1()): each request is
+ * issued at its recorded cycle, open loop, and the L2 and memory statistics
+ * are printed along with the average latency below the L1.
+ *
+ * The recorded times come from the run that recorded them: a slower L2 does
+ * not delay the L1 misses that follow. The state a fast-forward or a
+ * checkpoint leaves in the L2 is not recorded either; the replay starts with
+ * empty caches.
+ */
+class l1_filter_c {
+public:
+  l1_filter_c() : m_num_records(0) {}
+
+  bool record(const std::string& filename, memory_hierarchy_c* mm, core_c* core);  ///< write the L1 misses from now on
+  bool finish(core_c* core);                   ///< complete the file at the end of the run
+
+  static bool replay(const std::string& filename, config_c& config);
+
+private:
+  void write(mem_req_s* req, bool to_memory);
+
+  std::ofstream m_out;
+  memory_hierarchy_c* m_mm;
+  core_c* m_core;
+  counter m_num_records;
+};
+
+#endif // !__L1_FILTER_H__
@@ -0,0 +1,139 @@
+// ECE 430.322: Computer Organization
+// Lab 4: Memory System Simulation
+
+#include "latency_grid.h"
+#include "memory_system/prefetcher.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+/**
+ * The model needs requests that run alone, with fixed latencies, and hits
+ * and misses that do not depend on time.
+ */
+std::string latency_grid_c::check(const config_c& config, int num_cores) {
+  if (num_cores != 1) return "needs a single core";
+  if (!config.is_single_request()) return "needs single_request = 1";
+  if (config.get_core_model() != CORE_IN_ORDER) return "needs the in-order core";
+  if (config.get_memory_model() != static_cast<int>(MemoryModel::SIMPLE)) return "needs the simple memory model";
+  if (config.get_l1_split()) return "needs a unified L1 (its I and D requests overlap)";
+  if (config.get_victim_cache_size()) return "needs no victim cache";
+  if (config.get_ifetch_prefetcher()) return "needs no prefetcher";
+  for (auto& level : config.get_cache_levels()) {
+    if (level.m_prefetcher != PREF_NONE) return "needs no prefetcher";
+  }
+  if (config.get_sample_period()) return "does not work with sampling";
+  if (!config.get_checkpoint_save().empty()) return "does not save checkpoints";
+  return "";
+}
+
+latency_grid_c::latency_grid_c(const config_c& config) : m_config(config), m_num_other(0), m_num_insts(0) {
+  const std::vector<cache_level_s>& levels = config.get_cache_levels();
+  for (auto& level : levels) m_latencies.push_back(level.m_latency);
+  m_served.assign(levels.size() + 1, 0);
+
+  // a missing list keeps the configured latency; so does a level that does not exist
+  std::vector<int> l1d = config.get_grid_l1d_latency();
+  std::vector<int> l2 = config.get_grid_l2_latency();
+  std::vector<int> memory = config.get_grid_memory_latency();
+  if (l1d.empty() || levels.size() < 1) l1d.assign(1, levels.size() < 1 ? 0 : levels[0].m_latency);
+  if (l2.empty() || levels.size() < 2) l2.assign(1, levels.size() < 2 ? 0 : levels[1].m_latency);
+  if (memory.empty()) memory.assign(1, config.get_memory_latency());
+
+  for (auto a : l1d) {
+    for (auto b : l2) {
+      for (auto c : memory) m_points.push_back(grid_point_s{a, b, c});
+    }
+  }
+}
+
+/**
+ * This runs the rest of the trace functionally on a (warmed) hierarchy and
+ * counts the requests served at each level.
+ */
+void latency_grid_c::profile(memory_hierarchy_c* mm, core_c* core) {
+  counter num_insts = core->m_num_insts;
+  mm->begin_fast_forward();
+  core->profile(m_served, m_num_other);
+  mm->end_fast_forward(false);
+  m_num_insts = core->m_num_insts - num_insts;
+}
+
+counter latency_grid_c::predict_cycles(const grid_point_s& point) const {
+  std::vector<int> latencies = m_latencies;
+  if (latencies.size() > 0) latencies[0] = point.m_l1d_latency;
+  if (latencies.size() > 1) latencies[1] = point.m_l2_latency;
+
+  // each request takes its latency plus the cycle to send the next record
+  counter cycles = m_num_other;
+  counter above = 0;                   // 2 * sum (L_i + 1) over the levels above
+  for (unsigned ii = 0; ii < latencies.size(); ++ii) {
+    cycles += m_served[ii] * (above + latencies[ii] + 1);
+    above += 2 * (latencies[ii] + 1);
+  }
+  cycles += m_served.back() * (above + point.m_memory_latency + 2);
+  return cycles;
+}
+
+void latency_grid_c::print_stats() {
+  const std::vector<cache_level_s>& levels = m_config.get_cache_levels();
+  std::cout << "------------------------------" << std::endl;
+  std::cout << "Latency Grid" << std::endl;
+  std::cout << "------------------------------" << std::endl;
+  for (unsigned ii = 0; ii < levels.size(); ++ii) {
+    std::cout << "requests served by " << levels[ii].m_name << ": " << m_served[ii] << std::endl;
+  }
+  std::cout << "requests served by memory: " << m_served.back() << std::endl;
+  std::cout << "other records: " << m_num_other << std::endl;
+  std::cout << "number of insts: " << m_num_insts << std::endl;
+
+  // the model is linear: its terms are its differences from the all-zero point
+  counter base = predict_cycles(grid_point_s{0, 0, 0});
+  std::cout << "cycles = " << base
+            << " + " << predict_cycles(grid_point_s{1, 0, 0}) - base << " * l1d_latency"
+            << " + " << predict_cycles(grid_point_s{0, 1, 0}) - base << " * l2_latency"
+            << " + " << predict_cycles(grid_point_s{0, 0, 1}) - base << " * memory_latency" << std::endl;
+
+  std::cout << "l1d_latency l2_latency memory_latency CPI" << std::endl;
+  for (auto& point : m_points) {
+    double cpi = m_num_insts ? (double)predict_cycles(point) / m_num_insts : 0;
+    std::cout << std::setw(11) << point.m_l1d_latency << std::setw(11) << point.m_l2_latency
+              << std::setw(15) << point.m_memory_latency << " " << cpi << std::endl;
+  }
+}
+
+/**
+ * This runs grid_validate points spread evenly over the grid (the first and
+ * the last included) in full, and compares their cycles with the model. The
+ * difference may only come from the write-backs the timed run drains at the
+ * end, which take at most a trip from the L1 down to main memory.
+ * @return every point is within that bound
+ */
+bool latency_grid_c::validate(timed_run_t run) {
+  int num = std::min((int)m_points.size(), m_config.get_grid_validate());
+  if (num <= 0) return true;
+
+  std::cout << "------------------------------" << std::endl;
+  std::cout << "Latency Grid Validation" << std::endl;
+  std::cout << "------------------------------" << std::endl;
+  bool ok = true;
+  for (int ii = 0; ii < num; ++ii) {
+    const grid_point_s& point = m_points[num == 1 ? 0 : (size_t)ii * (m_points.size() - 1) / (num - 1)];
+    config_c config = m_config;
+    config.set_latencies(point.m_l1d_latency, point.m_l2_latency, point.m_memory_latency);
+
+    counter cycles;
+    if (!run(config, cycles)) return false;
+    counter model = predict_cycles(point);
+    counter bound = point.m_memory_latency + 2;
+    for (auto& level : config.get_cache_levels()) bound += level.m_latency + 1;
+    bool pass = (cycles >= model && cycles - model <= bound);
+    ok = ok && pass;
+
+    std::cout << "l1d_latency " << point.m_l1d_latency << ", l2_latency " << point.m_l2_latency
+              << ", memory_latency " << point.m_memory_latency << ": model " << model
+              << " cycles, timed " << cycles << " cycles (" << (pass ? "ok" : "MISMATCH") << ")" << std::endl;
+  }
+  return ok;
+}
@@ -0,0 +1,65 @@
+// ECE 430.322: Computer Organization
+// Lab 4: Memory System Simulation
+
+#ifndef __LATENCY_GRID_H__
+#define __LATENCY_GRID_H__
+
+#include "memory_system/memory_hierarchy.h"
+#include "core/core.h"
+#include "config.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+/***
+ *
+ * @class latency grid (latency_grid_c)
+ *
+ * With one in-order core in single-request mode, every request runs alone
+ * through the hierarchy, and whether it hits or misses at each level does
+ * not depend on the latencies. A request served at cache level k (from 1)
+ * returns 2 * sum_{i<k} (L_i + 1) + L_k cycles after it is sent, and one
+ * served by main memory 2 * sum_{i<=N} (L_i + 1) + M + 1 cycles after; the
+ * core sends the next record a cycle later. The cycle count is thus linear
+ * in the latencies, with the number of requests served at each level as
+ * the coefficients.
+ *
+ * profile() counts them in one functional pass (see core_c::profile()),
+ * and print_stats() prints the linear model and the CPI of every point of
+ * the grid_l1d_latency x grid_l2_latency x grid_memory_latency grid.
+ * validate() runs grid_validate points of the grid in full and compares.
+ * The model leaves out the write-backs still in flight when the last
+ * request returns, which the timed run waits for (a few cycles at most).
+ */
+class latency_grid_c {
+public:
+  /// a timed run of a configuration: the number of cycles (false: the run failed)
+  using timed_run_t = std::function<bool(config_c& config, counter& num_cycles)>;
+
+  static std::string check(const config_c& config, int num_cores);  ///< why the model does not hold ("": it does)
+
+  latency_grid_c(const config_c& config);
+  void profile(memory_hierarchy_c* mm, core_c* core);
+  void print_stats();
+  bool validate(timed_run_t run);
+
+private:
+  struct grid_point_s {
+    int m_l1d_latency;
+    int m_l2_latency;
+    int m_memory_latency;
+  };
+
+  counter predict_cycles(const grid_point_s& point) const;
+
+  config_c m_config;
+  std::vector<int> m_latencies;        ///< latency of each cache level in the config
+  std::vector<grid_point_s> m_points;  ///< the grid, memory latency varying fastest
+
+  std::vector<counter> m_served;       ///< requests served at each cache level, then by main memory
+  counter m_num_other;                 ///< records that send no request (a cycle each)
+  counter m_num_insts;
+};
+
+#endif // !__LATENCY_GRID_H__
@@ -3,29 +3,269 @@
 
 #include "memory_system/memory_hierarchy.h"
 #include "core/core.h"
+#include "atom/barrier.h"
+#include "checkpoint.h"
 #include "config.h"
+#include "l1_filter.h"
+#include "latency_grid.h"
 
 #include <cstdio>
 #include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * This runs several cores, each with its own trace, on one memory hierarchy.
+ * Every cycle, each core issues its next record, and the shared hierarchy is
+ * ticked once. The simulation ends when all the cores are done, their L1s
+ * are idle and all the write-backs are committed.
+ */
+static void run_multi_core_sim(memory_hierarchy_c* mm, std::vector<core_c*>& cores) {
+  while (true) {
+    bool all_done = true;
+    for (auto core : cores) {
+      core->fetch();
+    }
+
+    mm->run_a_cycle();
+
+    for (auto core : cores) {
+      core->tick();
+      if (!core->is_done() || !mm->is_core_idle(core->m_core_id)) all_done = false;
+    }
+
+    if (all_done && mm->is_wb_done()) break;
+  }
+
+  for (auto core : cores) {
+    core->print_stats();
+  }
+}
+
+/**
+ * Parallel version of run_multi_core_sim(). Each core and its L1 run on their
+ * own thread; L2 and main memory run on this thread. Time advances in quanta
+ * of at most the lookahead (the L1 latency): first all the core threads run
+ * the quantum, then the shared levels run the same cycles, with barriers in
+ * between. A message from the shared levels takes effect at an L1 no earlier
+ * than a lookahead after it is sent, i.e., in a later quantum, so the result
+ * is the same as run_multi_core_sim().
+ */
+static void run_parallel_sim(memory_hierarchy_c* mm, std::vector<core_c*>& cores, int quantum) {
+  int num_cores = cores.size();
+  barrier_c barrier(num_cores + 1);
+  bool stop = false;
+
+  // quiet[core][ii]: core done and its L1 idle at the end of the ii-th cycle of the quantum
+  std::vector<std::vector<char> > quiet(num_cores, std::vector<char>(quantum, 0));
+
+  mm->enable_parallel();
+
+  std::vector<std::thread> threads;
+  for (int core_id = 0; core_id < num_cores; ++core_id) {
+    threads.emplace_back([&, core_id] {
+      core_c* core = cores[core_id];
+      while (true) {
+        barrier.wait();
+        if (stop) break;
+
+        for (int ii = 0; ii < quantum; ++ii) {
+          core->fetch();
+          mm->run_core_cycle(core_id);
+          core->tick();
+          quiet[core_id][ii] = core->is_done() && mm->is_core_idle(core_id);
+        }
+        barrier.wait();
+      }
+    });
+  }
+
+  std::vector<size_t> num_sent(num_cores);
+  bool done = false;
+  while (!done) {
+    for (int core_id = 0; core_id < num_cores; ++core_id) {
+      num_sent[core_id] = mm->get_num_sent_to_core(core_id);
+    }
+
+    // cores run the quantum
+    barrier.wait();
+    barrier.wait();
+
+    // then the shared levels run the same cycles
+    for (int ii = 0; ii < quantum && !done; ++ii) {
+      mm->run_shared_cycle();
+
+      // a message still on its way to a core means its L1 is not idle yet
+      done = mm->is_shared_wb_done();
+      for (int core_id = 0; core_id < num_cores; ++core_id) {
+        done = done && quiet[core_id][ii] && mm->get_num_sent_to_core(core_id) == num_sent[core_id];
+      }
+    }
+  }
+
+  stop = true;
+  barrier.wait();
+  for (auto& thread : threads) thread.join();
+
+  for (auto core : cores) {
+    core->print_stats();
+  }
+}
+
+/**
+ * This fast-forwards the cores in turn, one record at a time, so that the
+ * shared levels see their accesses interleaved.
+ */
+static void fast_forward(memory_hierarchy_c* mm, std::vector<core_c*>& cores, counter num_records) {
+  mm->begin_fast_forward();
+  for (counter ii = 0; ii < num_records; ++ii) {
+    bool any = false;
+    for (auto core : cores) {
+      if (core->fast_forward(1)) any = true;
+    }
+    if (!any) break;
+  }
+  mm->end_fast_forward();
+}
+
+/**
+ * The warm-up before the timed simulation: the state of a checkpoint, the
+ * records to skip, then the fast-forward, and a checkpoint of the result.
+ */
+static bool warm_up(memory_hierarchy_c* mm, std::vector<core_c*>& cores, config_c& config) {
+  const std::string& load = config.get_checkpoint_load();
+  if (!load.empty() && !checkpoint_c::load(load, mm, cores)) {
+    fprintf(stderr, "cannot load checkpoint %s\n", load.c_str());
+    return false;
+  }
+
+  if (config.get_trace_skip()) {
+    for (auto core : cores) {
+      if (!core->skip_records(config.get_trace_skip())) {
+        fprintf(stderr, "core %d: the trace has fewer records than trace_skip\n", core->m_core_id);
+        return false;
+      }
+    }
+  }
+
+  if (config.get_fast_forward()) {
+    fast_forward(mm, cores, config.get_fast_forward());
+  }
+
+  const std::string& save = config.get_checkpoint_save();
+  if (!save.empty() && !checkpoint_c::save(save, mm, cores)) {
+    fprintf(stderr, "cannot save checkpoint %s\n", save.c_str());
+    return false;
+  }
+  return true;
+}
+
+/**
+ * The latency grid: one functional pass over the trace (after the warm-up)
+ * gives the CPI for every combination of the grid latencies; the points to
+ * validate are then timed in full, each on a hierarchy of its own.
+ */
+static bool run_latency_grid(memory_hierarchy_c* mm, core_c* core, config_c& config, const std::string& trace) {
+  latency_grid_c grid(config);
+  grid.profile(mm, core);
+  grid.print_stats();
+
+  return grid.validate([&](config_c& timed, counter& num_cycles) {
+    memory_hierarchy_c* timed_mm = new memory_hierarchy_c(timed, 1);
+    std::vector<core_c*> timed_cores(1, core_c::create(timed_mm, 0));
+    bool ok = timed_cores[0]->open_trace(trace) && warm_up(timed_mm, timed_cores, timed);
+    if (ok) {
+      timed_cores[0]->run_to_end();
+      num_cycles = timed_cores[0]->m_cycle;
+    }
+    delete timed_mm;
+    delete timed_cores[0];
+    return ok;
+  });
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 int main(int argc, char** argv) {
-  if (argc != 3) {
-    fprintf(stderr, "[Usage]: %s <trace> <config file>\n", argv[0]);
+  if (argc < 3) {
+    fprintf(stderr, "[Usage]: %s <trace> [<trace> ...] <config file>\n", argv[0]);
     return -1;
   }
   
-  config_c config(argv[2]);
+  // one core per trace
+  int num_cores = argc - 2;
+  config_c config(argv[argc - 1]);
 
-  memory_hierarchy_c* mm = new memory_hierarchy_c(config);
-  core_c* m_core = new core_c(mm);
+  // "l1filter:<file>": replay the L1 misses of an earlier run below the L1
+  std::string first = argv[1];
+  if (num_cores == 1 && first.compare(0, 9, "l1filter:") == 0) {
+    if (!l1_filter_c::replay(first.substr(9), config)) {
+      fprintf(stderr, "cannot replay %s\n", first.substr(9).c_str());
+      return -1;
+    }
+    return 0;
+  }
 
-  m_core->run_sim(argv[1]);
+  std::string error = memory_hierarchy_c::check(config, num_cores);
+  if (!error.empty()) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return -1;
+  }
+
+  uint64_t period = config.get_sample_period();
+  if (period && (config.get_sample_size() == 0 || config.get_sample_warmup() + config.get_sample_size() > period)) {
+    fprintf(stderr, "sampling needs sample_size > 0 and sample_warmup + sample_size <= sample_period\n");
+    return -1;
+  }
+
+  memory_hierarchy_c* mm = new memory_hierarchy_c(config, num_cores);
+  std::vector<core_c*> cores;
+  for (int core = 0; core < num_cores; ++core) {
+    cores.push_back(core_c::create(mm, core));
+  }
+
+  for (int core = 0; core < num_cores; ++core) {
+    if (!cores[core]->open_trace(argv[core + 1])) {
+      fprintf(stderr, "cannot open %s\n", argv[core + 1]);
+      return -1;
+    }
+  }
+  std::string grid_error = config.get_latency_grid() ? latency_grid_c::check(config, num_cores) : "";
+  if (!grid_error.empty()) {
+    fprintf(stderr, "latency grid: %s\n", grid_error.c_str());
+    return -1;
+  }
+  if (!warm_up(mm, cores, config)) return -1;
+
+  if (config.get_latency_grid()) {
+    return run_latency_grid(mm, cores[0], config, argv[1]) ? 0 : -1;
+  }
+
+  if (num_cores == 1) {
+    l1_filter_c filter;
+    const std::string& record = config.get_l1_filter_record();
+    if (!record.empty() && (config.get_sample_period() || !filter.record(record, mm, cores[0]))) {
+      fprintf(stderr, "cannot record the L1 misses to %s\n", record.c_str());
+      return -1;
+    }
+    cores[0]->run_sim(argv[1]);
+    if (!record.empty() && !filter.finish(cores[0])) {
+      fprintf(stderr, "cannot write %s\n", record.c_str());
+      return -1;
+    }
+  } else {
+    if (config.get_parallel_sim()) {
+      int quantum = config.get_sim_quantum();
+      if (quantum <= 0 || quantum > mm->get_lookahead()) quantum = mm->get_lookahead();
+      run_parallel_sim(mm, cores, quantum);
+    } else {
+      run_multi_core_sim(mm, cores);
+    }
+  }
   
   mm->print_stats();
   //mm->dump(true);
 
   delete mm;
-  delete m_core;
+  for (auto core : cores) delete core;
   return 0;
 }
@@ -2,6 +2,7 @@
 // Lab 4: Memory System Simulation
 
 #include "cache.h"
+#include <algorithm>
 #include <cstring>
 #include <list>
 #include <cassert>
@@ -18,13 +19,12 @@ cache_c::cache_c(std::string name, int level, int num_set, int assoc, int line_s
   m_out_queue  = new queue_c();
   m_fill_queue = new queue_c();
   m_wb_queue   = new queue_c();
+  m_mem_wb_queue = new queue_c();
 
   m_in_flight_wb_queue = new queue_c();
 
   m_id = 0;
 
-  m_prev_i = nullptr;
-  m_prev_d = nullptr;
   m_next = nullptr;
   m_memory = nullptr;
 
@@ -36,8 +36,39 @@ cache_c::cache_c(std::string name, int level, int num_set, int assoc, int line_s
   
   m_num_backinvals = 0;
   m_num_writebacks_backinval = 0;
+  m_num_backinval_probes = 0;
+  m_num_backinval_skipped = 0;
+  m_presence_bit = 0;
+  m_inclusion = INCL_INCLUSIVE;
+  m_num_victims_inserted = 0;
+  m_num_moved_up = 0;
 
-  
+  m_arb_next = 0;
+  m_num_ports = 1;
+  m_down_link = nullptr;
+
+  m_coherence = false;
+  m_core_id = 0;
+  m_num_coh_misses = 0;
+  m_num_upgrades = 0;
+  m_num_coh_invals_recv = 0;
+  m_num_downgrades_recv = 0;
+  m_num_coh_invals_sent = 0;
+  m_num_downgrades_sent = 0;
+  m_num_invals_filtered = 0;
+
+  m_prefetcher = nullptr;
+  m_inst_prefetcher = nullptr;
+  m_num_pf_issued = 0;
+  m_num_pf_useful = 0;
+  m_num_pf_late = 0;
+
+  m_warming = false;
+  m_l1_filtered = false;
+
+  m_victim_cache = nullptr;
+  m_victim_queue = new queue_c();
+  m_num_trips_saved = 0;
 }
 
 
@@ -46,68 +77,298 @@ cache_c::~cache_c() {
   delete m_out_queue;
   delete m_fill_queue;
   delete m_wb_queue;
+  delete m_mem_wb_queue;
   delete m_in_flight_wb_queue;
+  for (auto queue : m_arb_queues) delete queue;
+  delete m_prefetcher;
+  delete m_inst_prefetcher;
+  delete m_victim_cache;
+  delete m_victim_queue;
 }
 
 /** 
- * Run a cycle for cache (DO NOT CHANGE)
+ * Run a cycle for cache: process the queues, then add the lines each core
+ * holds to its occupancy.
  */
 void cache_c::run_a_cycle() {
   // process the queues in the following order 
-  // wb -> fill -> out -> in
+  // snoop -> wb -> fill -> victim -> out -> in
+
+  process_snoop_queue();
 
   process_wb_queue();
 
   process_fill_queue();
 
+  process_victim_queue();
+
   process_out_queue(); 
 
   process_in_queue();
 
+  for (unsigned ii = 0; ii < m_core_lines.size(); ++ii) {
+    m_core_line_cycles[ii] += m_core_lines[ii];
+  }
+
   ++m_cycle;
 }
 
+/**
+ * This back-invalidates a line in the previous-level caches whose presence
+ * bit is set; the others are skipped.
+ */
+void cache_c::invalidate_uppers(uint64_t presence, addr_t address) {
+  for (int ii = 0; ii < (int)m_uppers.size(); ++ii) {
+    if (!(presence & (1ull << ii))) {
+      m_num_backinval_skipped++;
+      continue;
+    }
+    m_num_backinval_probes++;
+
+    if (m_warming)
+      m_uppers[ii]->back_invalidate(address);
+    else if (!m_up_links.empty())
+      m_up_links[m_upper_core[ii]]->push(link_msg_s{m_cycle, LINK_INVAL, nullptr, address, ii});
+    else if (m_prev_d.size() > 1)
+      m_uppers[ii]->queue_snoop(address, LINK_INVAL);
+    else
+      m_uppers[ii]->back_invalidate(address);
+  }
+}
+
 void cache_c::back_invalidate(addr_t address) {
   int set_idx = (address / this->m_line_size) % this->m_num_sets;
-  int tag = address / this->m_line_size / this->m_num_sets;
+  addr_t tag = address / this->m_line_size / this->m_num_sets;
 
     for (int i = 0; i < m_set[set_idx]->m_assoc; i++) {
       if (m_set[set_idx]->m_entry[i].m_valid && m_set[set_idx]->m_entry[i].m_tag == tag) {
+        // an inclusive middle level passes the invalidation up first
+        if (m_inclusion == INCL_INCLUSIVE) invalidate_uppers(m_set[set_idx]->m_entry[i].m_presence, address);
         m_set[set_idx]->m_entry[i].m_valid = false;
+        m_set[set_idx]->m_entry[i].m_coh_inval = false;
         //std::cout << "Back invalidated!!" << std::endl;
         m_num_backinvals++;
         //do writeback due to invalidating dirty, straight to memory
         if (m_set[set_idx]->m_entry[i].m_dirty) {
-           //std::cout << "writeback occured from Back invalidated!!" << std::endl;
           m_set[set_idx]->m_entry[i].m_dirty = false;
           m_num_writebacks_backinval++;
+          send_to_memory(create_wb_req(address));
         }
         break;
       }
     } 
+
+  // the line may also sit in the victim cache
+  cache_entry_c* line = m_victim_cache ? m_victim_cache->find_line(address) : nullptr;
+  if (line) {
+    line->m_valid = false;
+    m_num_backinvals++;
+    if (line->m_dirty) {
+      line->m_dirty = false;
+      m_num_writebacks_backinval++;
+      send_to_memory(create_wb_req(address));
+    }
+  }
 }
 
-bool cache_c::evict_and_bring_new(int set_idx, int tag, int req_type, bool set_dirty) {
-  bool evicted, dirty_evicted; int evicted_tag;
+bool cache_c::evict_and_bring_new(int set_idx, addr_t tag, int req_type, bool set_dirty) {
+  bool evicted, dirty_evicted; addr_t evicted_tag;
   m_set[set_idx]->evict_and_bring_new(tag, set_dirty, evicted, dirty_evicted, evicted_tag);
 
+  if (!evicted) return false;
+
+  // the new line took the victim's entry (now MRU), which still holds the victim's owner/presence
+  cache_set_c* set = m_set[set_idx];
+  cache_entry_c* victim = &set->m_entry[set->access_order[0]];
+  if (!m_core_lines.empty()) {
+    m_core_lines[victim->m_owner]--;
+  }
+
   //assemble evicted address and back invalidate
-  if (evicted && m_level != L1) {
-    addr_t evicted_addr = m_line_size * set_idx + evicted_tag * m_line_size * m_num_sets;
+  addr_t evicted_addr = m_line_size * set_idx + evicted_tag * m_line_size * m_num_sets;
 
-    if (req_type == REQ_DFETCH || req_type == REQ_DSTORE)
-      m_prev_d->back_invalidate(evicted_addr);
-    else if (req_type == REQ_IFETCH)
-      m_prev_i->back_invalidate(evicted_addr);
+  // another copy of the line (two misses to it were filled) keeps the upper levels included
+  bool inclusive = (m_inclusion == INCL_INCLUSIVE);
+  cache_entry_c* copy = (m_uppers.empty() || !inclusive) ? nullptr : find_entry(evicted_addr);
+  if (copy) {
+    copy->m_presence |= victim->m_presence;
+    copy->m_fill_land = std::max(copy->m_fill_land, victim->m_fill_land);
+    victim->m_presence = 0;
+  }
+
+  if (inclusive) invalidate_uppers(victim->m_presence, evicted_addr);
+
+  // an L1 victim moves to the victim cache; the line that leaves is the one the victim cache evicts
+  if (m_victim_cache) {
+    addr_t vc_addr;
+    bool vc_dirty;
+    if (!m_victim_cache->insert(evicted_addr, dirty_evicted, victim->m_shared, vc_addr, vc_dirty)) return false;
+    evicted_addr = vc_addr;
+    dirty_evicted = vc_dirty;
+  }
+
+  // tell the next level once this cache holds no copy of the victim
+  if (m_next && m_next->m_inclusion == INCL_INCLUSIVE && !holds(evicted_addr)) {
+    if (m_down_link && !m_warming)
+      m_down_link->push(link_msg_s{m_cycle, LINK_EVICT, nullptr, evicted_addr, m_presence_bit});
+    else
+      m_next->evict_notify(evicted_addr, m_presence_bit);
+  }
+
+  //the dirty victim is written back to the next level; an exclusive next level takes clean victims too
+  if (dirty_evicted || (m_next && m_next->m_inclusion == INCL_EXCLUSIVE)) {
+    mem_req_s* wb = create_wb_req(evicted_addr);
+    wb->m_dirty = dirty_evicted;
+    send_wb(wb);
   }
   return dirty_evicted;
 }
 
+void cache_c::send_wb(mem_req_s* wb) {
+  if (!m_warming) {
+    m_wb_queue->push(wb);
+    m_in_flight_wb_queue->push(wb);
+  } else if (m_next) {
+    m_next->commit_wb(wb);
+  } else {
+    delete wb;  // main memory keeps no state
+  }
+}
+
+/**
+ * This creates a write-back request for a dirty line. The request is owned
+ * by the component that commits it (the next-level cache or main memory).
+ */
+mem_req_s* cache_c::create_wb_req(addr_t address) {
+  mem_req_s* wb = new mem_req_s(address, REQ_WB);
+  wb->m_id = 0;
+  wb->m_in_cycle = m_cycle;
+  wb->m_rdy_cycle = m_cycle;
+  wb->m_done = false;
+  wb->m_dirty = true;
+  wb->m_core_id = m_core_id;
+  return wb;
+}
+
+/**
+ * This creates a prefetch request issued by this cache. The request is freed
+ * when the prefetched line is filled back into this cache.
+ */
+mem_req_s* cache_c::create_pf_req(addr_t address, int type) {
+  mem_req_s* pf = new mem_req_s(address, type);
+  pf->m_id = 0;
+  pf->m_in_cycle = m_cycle;
+  pf->m_rdy_cycle = m_cycle;
+  pf->m_done = false;
+  pf->m_dirty = false;
+  pf->m_pf_level = m_level;
+  return pf;
+}
+
+/**
+ * This notifies the prefetcher of a demand access and turns its candidates
+ * into prefetch requests. Lines that are already present or already being
+ * prefetched are skipped. Prefetches keep the I/D side of the trigger so the
+ * fill is routed back to the right cache.
+ */
+void cache_c::train_prefetcher(mem_req_s* req, bool hit) {
+  // instruction fetches go to the instruction-side prefetcher if there is one
+  prefetcher_c* prefetcher = m_prefetcher;
+  if (m_inst_prefetcher && req->m_type == REQ_IFETCH) prefetcher = m_inst_prefetcher;
+  if (!prefetcher) return;
+
+  prefetcher->on_access(req->m_addr, req->m_type, hit);
+  if (!hit) prefetcher->on_miss(req->m_addr, req->m_type);
+
+  int type = (req->m_type == REQ_IFETCH) ? REQ_IFETCH : REQ_DFETCH;
+  for (auto addr : prefetcher->m_candidates) {
+    if (holds(addr) || m_pf_in_flight.count(addr)) continue;
+
+    mem_req_s* pf = create_pf_req(addr, type);
+    pf->m_core_id = req->m_core_id;
+    m_pf_in_flight[addr];
+    m_out_queue->push(pf);
+    m_num_pf_issued++;
+  }
+  prefetcher->m_candidates.clear();
+}
+
+/**
+ * This installs the line of a completed prefetch and releases the demand
+ * requests that missed on it while it was in flight (late prefetches).
+ */
+void cache_c::complete_prefetch(mem_req_s* req) {
+  auto waiters = m_pf_in_flight.find(req->m_addr);
+  cache_entry_c* entry = find_entry(req->m_addr);
+
+  // a prefetch is late if a demand request had to wait for it
+  bool late = false;
+  entry->m_prefetch = waiters->second.empty();
+  for (auto waiter : waiters->second) {
+    if (waiter->m_pf_level == 0) late = true;
+
+    if (m_coherence && waiter->m_type == REQ_DSTORE && entry->m_shared) {
+      // the prefetch brought the line in S; the store still needs ownership
+      m_num_upgrades++;
+      m_out_queue->push(waiter);
+    } else if (is_top()) {
+      if (waiter->m_type == REQ_DSTORE && !m_l1_filtered) entry->m_dirty = true;
+      done_func(waiter);
+    } else {
+      if (m_inclusion == INCL_EXCLUSIVE && probe(waiter->m_addr)) move_up(waiter);
+      fill_prev(waiter);
+    }
+  }
+
+  if (late) m_num_pf_late++;
+  m_pf_in_flight.erase(waiters);
+  delete req;
+}
+
 void cache_c::configure_neighbors(cache_c* prev_i, cache_c* prev_d, cache_c* next, simple_mem_c* memory) {
+  // a top-level cache has no previous level
+  int num_prev = (prev_i || prev_d) ? 1 : 0;
+  configure_neighbors(std::vector<cache_c*>(num_prev, prev_i), std::vector<cache_c*>(num_prev, prev_d), next, memory);
+}
+
+/**
+ * This connects a cache shared by several cores. prev_i[c] and prev_d[c] are
+ * the caches of core c; requests and fills are routed by mem_req_s::m_core_id.
+ * With more than one core, the requests from the cores go through round-robin
+ * input arbitration (see arbitrate()).
+ */
+void cache_c::configure_neighbors(const std::vector<cache_c*>& prev_i, const std::vector<cache_c*>& prev_d,
+                                  cache_c* next, simple_mem_c* memory) {
+  assert(prev_i.size() == prev_d.size());
   m_prev_i = prev_i;
   m_prev_d = prev_d;
   m_next = next;
   m_memory = memory;
+
+  int num_cores = prev_d.size();
+  m_core_accesses.assign(num_cores, 0);
+  m_core_misses.assign(num_cores, 0);
+  m_core_arb_stalls.assign(num_cores, 0);
+  m_core_lines.clear();
+  m_core_line_cycles.clear();
+
+  // one presence bit per distinct previous-level cache (I and D may be the same cache)
+  m_uppers.clear();
+  m_upper_core.clear();
+  for (int core = 0; core < num_cores; ++core) {
+    for (cache_c* prev : {prev_d[core], prev_i[core]}) {
+      if (!prev || std::find(m_uppers.begin(), m_uppers.end(), prev) != m_uppers.end()) continue;
+      prev->m_presence_bit = m_uppers.size();
+      m_uppers.push_back(prev);
+      m_upper_core.push_back(core);
+    }
+  }
+  assert(m_uppers.size() <= 64 && "presence bits are kept in a 64-bit mask");
+  if (num_cores > 1) {
+    for (int ii = 0; ii < num_cores; ++ii) m_arb_queues.push_back(new queue_c());
+    m_core_lines.assign(num_cores, 0);
+    m_core_line_cycles.assign(num_cores, 0);
+  }
 }
 
 /**
@@ -122,9 +383,9 @@ void cache_c::configure_neighbors(cache_c* prev_i, cache_c* prev_d, cache_c* nex
  *
  */
 bool cache_c::fill(mem_req_s* req) {
-  //m_cycle += m_latency;
-  req->m_rdy_cycle += m_latency;
-  m_fill_queue->push(req);
+  req->m_rdy_cycle = m_cycle + m_latency;
+  if (req->m_type == REQ_WB) m_in_flight_wb_queue->push(req);
+  return m_fill_queue->push(req);
 }
 
 /**
@@ -136,9 +397,334 @@ bool cache_c::fill(mem_req_s* req) {
  * a new ready cycle needs to be set for the request .
  */
 bool cache_c::access(mem_req_s* req) {
-  //m_cycle += m_latency;
-  req->m_rdy_cycle += m_latency;
-  m_in_queue->push(req);
+  if (!m_arb_queues.empty()) {
+    // wait for an input port; m_rdy_cycle keeps the arrival cycle until then
+    req->m_rdy_cycle = m_cycle;
+    return m_arb_queues[req->m_core_id]->push(req);
+  }
+  req->m_rdy_cycle = m_cycle + m_latency;
+  return m_in_queue->push(req);
+}
+
+/**
+ * This puts requests that one core sent in the same cycle into in_queue (or
+ * the core's arbitration queue) with a single insertion; the result is that
+ * of access() on each in order.
+ */
+int cache_c::access_batch(mem_req_s* const* reqs, int num) {
+  bool arbitrated = !m_arb_queues.empty();
+  counter rdy_cycle = arbitrated ? m_cycle : m_cycle + m_latency;
+  for (int ii = 0; ii < num; ++ii) reqs[ii]->m_rdy_cycle = rdy_cycle;
+  queue_c* queue = arbitrated ? m_arb_queues[reqs[0]->m_core_id] : m_in_queue;
+  return queue->push(reqs, num);
+}
+
+/**
+ * This sends the data of a request to the cache of the core that issued it.
+ */
+void cache_c::fill_prev(mem_req_s* req) {
+  int core = req->m_core_id;
+  int slot = (m_prev_d.size() == 1) ? 0 : core;  // a private level has one previous-level cache
+  cache_c* prev = (req->m_type == REQ_IFETCH) ? m_prev_i[slot] : m_prev_d[slot];
+
+  if (m_inclusion == INCL_INCLUSIVE) {
+    cache_entry_c* entry = find_entry(req->m_addr);
+    if (m_coherence) coherence_request(entry, req);
+    entry->m_presence |= 1ull << prev->m_presence_bit;
+    entry->m_fill_land = m_warming ? 0 : m_cycle + 1 + prev->m_latency;
+  }
+
+  if (m_warming) {
+    prev->fill_line(req);
+  } else if (!m_up_links.empty()) {
+    m_up_links[core]->push(link_msg_s{m_cycle, LINK_FILL, req, 0, prev->m_presence_bit});
+  } else {
+    prev->fill(req);
+  }
+}
+
+/**
+ * Exclusive: the line of a hit leaves this cache for the previous level and
+ * takes its dirty state with it.
+ */
+void cache_c::move_up(mem_req_s* req) {
+  cache_entry_c* entry = find_entry(req->m_addr);
+  req->m_dirty = entry->m_dirty;
+  entry->m_valid = false;
+  entry->m_dirty = false;
+  if (!m_core_lines.empty()) m_core_lines[entry->m_owner]--;
+  m_num_moved_up++;
+}
+
+/**
+ * An L1 miss probes the victim cache in parallel with the next level. On a
+ * hit, the line is swapped with the L1 victim right away, the next-level
+ * access is not sent, and the request completes after the victim cache
+ * latency. A store to an S line still needs ownership from the next level.
+ */
+bool cache_c::swap_victim(mem_req_s* req) {
+  bool dirty, shared;
+  if (!m_victim_cache->lookup(req->m_addr, dirty, shared)) return false;
+
+  cache_base_c::access(req->m_addr, FILL_INCLUDE, true);
+  cache_entry_c* entry = find_entry(req->m_addr);
+  entry->m_dirty = dirty;
+  entry->m_shared = shared;
+  entry->m_prefetch = false;
+  entry->m_coh_inval = false;
+
+  if (m_coherence && req->m_type == REQ_DSTORE && shared) {
+    m_num_upgrades++;
+    if (m_warming)
+      m_next->warm_access(req);
+    else
+      m_out_queue->push(req);
+    return true;
+  }
+
+  if (req->m_type == REQ_DSTORE) entry->m_dirty = true;
+  if (m_warming) return true;
+  req->m_rdy_cycle = m_cycle + m_victim_cache->get_latency();
+  m_victim_queue->push(req);
+  m_num_trips_saved++;
+  return true;
+}
+
+bool cache_c::holds(addr_t address) {
+  return probe(address) || (m_victim_cache && m_victim_cache->find_line(address));
+}
+
+/**
+ * NINE/exclusive: a victim of the previous level that is not here is
+ * allocated like a fill (a clean victim only comes from an exclusive level).
+ */
+void cache_c::insert_victim(mem_req_s* req) {
+  cache_base_c::access(req->m_addr, FILL_INCLUDE, true);
+  cache_entry_c* entry = find_entry(req->m_addr);
+  entry->m_dirty = req->m_dirty;
+  entry->m_prefetch = false;
+  entry->m_owner = req->m_core_id;
+  if (!m_core_lines.empty()) m_core_lines[req->m_core_id]++;
+  m_num_victims_inserted++;
+  delete req;
+}
+
+/**
+ * A previous-level cache evicted the line and holds no other copy of it.
+ * Further back-invalidations of the line skip that cache, and with MESI, the
+ * core is no longer a sharer once none of its caches holds the line. The bit
+ * stays set while a fill of the line is still on its way up.
+ */
+void cache_c::evict_notify(addr_t address, int cache) {
+  cache_entry_c* entry = find_entry(address);
+  if (!entry || (!m_warming && entry->m_fill_land >= m_cycle)) return;
+
+  entry->m_presence &= ~(1ull << cache);
+  if (!m_coherence) return;
+
+  int core = m_upper_core[cache];
+  for (int ii = 0; ii < (int)m_uppers.size(); ++ii) {
+    if (m_upper_core[ii] == core && (entry->m_presence & (1ull << ii))) return;
+  }
+  entry->m_sharers &= ~(1ull << core);
+  if (!entry->m_sharers) entry->m_excl = false;
+}
+
+void cache_c::send_to_memory(mem_req_s* req) {
+  if (m_warming) {
+    delete req;
+  } else if (m_down_link) {
+    m_down_link->push(link_msg_s{m_cycle, LINK_MEM, req, 0});
+  } else {
+    if (out_func) out_func(req, true);
+    // a full memory queue refuses it: it waits (in order, and still in flight) until process_out_queue()
+    if (!m_mem_wb_queue->empty() || !m_memory->access(req)) {
+      m_mem_wb_queue->push(req);
+      m_in_flight_wb_queue->push(req);
+    }
+  }
+}
+
+/**
+ * This sends a MESI invalidation or downgrade to the L1(s) of a core.
+ */
+void cache_c::send_snoop(int core, int type, addr_t address) {
+  if (m_warming) {
+    m_prev_d[core]->snoop(type, address);
+    if (m_prev_i[core] != m_prev_d[core]) m_prev_i[core]->snoop(type, address);
+    return;
+  }
+  if (!m_up_links.empty()) {
+    m_up_links[core]->push(link_msg_s{m_cycle, type, nullptr, address, -1});  // all the caches of the core
+    return;
+  }
+  m_prev_d[core]->queue_snoop(address, type);
+  if (m_prev_i[core] != m_prev_d[core]) m_prev_i[core]->queue_snoop(address, type);
+}
+
+/**
+ * With several cores, a back-invalidation (or a MESI invalidation/downgrade)
+ * from the shared level takes this cache's access latency to take effect,
+ * like a fill. This keeps the cores independent for m_latency cycles, which
+ * parallel simulation relies on.
+ */
+void cache_c::queue_snoop(addr_t address, int type) {
+  m_snoop_queue.push_back(link_msg_s{m_cycle + m_latency, type, nullptr, address});
+}
+
+void cache_c::process_snoop_queue() {
+  auto it = m_snoop_queue.begin();
+  for (; it != m_snoop_queue.end() && it->m_cycle <= m_cycle; ++it) {
+    snoop(it->m_type, it->m_addr);
+  }
+  m_snoop_queue.erase(m_snoop_queue.begin(), it);
+}
+
+void cache_c::snoop(int type, addr_t address) {
+  if (type == LINK_INVAL) {
+    back_invalidate(address);
+  } else if (type == LINK_COH_INVAL) {
+    coherence_invalidate(address);
+  } else {
+    downgrade(address);
+  }
+}
+
+/**
+ * [MESI Directory]
+ *
+ * The L2 is inclusive, so each L2 entry keeps the set of cores whose L1 may
+ * hold the line (m_sharers), and whether that single core holds it in E or M
+ * (m_excl). The L1s report their evictions (evict_notify), so the set only
+ * lags behind by the messages in flight. This runs when L2 sends a line up
+ * to a core:
+ * - a store (miss or upgrade from S) invalidates the copies of the other
+ *   sharers, and only theirs, and grants the line in M.
+ * - a read downgrades an E/M owner to S; the line is granted in E if no
+ *   other core has it, or in S otherwise.
+ */
+void cache_c::coherence_request(cache_entry_c* entry, mem_req_s* req) {
+  int num_cores = m_prev_d.size();
+  uint64_t self = 1ull << req->m_core_id;
+  uint64_t others = entry->m_sharers & ~self;
+  addr_t address = req->m_addr / m_line_size * m_line_size;
+
+  if (req->m_type == REQ_DSTORE) {
+    int num_invals = 0;
+    for (int core = 0; core < num_cores; ++core) {
+      if (!(others & (1ull << core))) continue;
+      send_snoop(core, LINK_COH_INVAL, address);
+      num_invals++;
+    }
+    m_num_coh_invals_sent += num_invals;
+    m_num_invals_filtered += num_cores - 1 - num_invals;
+    for (int ii = 0; ii < (int)m_uppers.size(); ++ii) {
+      if (m_upper_core[ii] != req->m_core_id) entry->m_presence &= ~(1ull << ii);
+    }
+    entry->m_sharers = self;
+    entry->m_excl = true;
+    req->m_shared = false;
+  } else {
+    if (entry->m_excl && others) {
+      for (int core = 0; core < num_cores; ++core) {
+        if (!(others & (1ull << core))) continue;
+        send_snoop(core, LINK_DOWNGRADE, address);
+        m_num_downgrades_sent++;
+      }
+    }
+    entry->m_sharers |= self;
+    entry->m_excl = !others;
+    req->m_shared = (others != 0);
+  }
+}
+
+/**
+ * Another core writes the line. The data of a modified copy is not written
+ * back: the writer becomes the owner of the line in M.
+ */
+void cache_c::coherence_invalidate(addr_t address) {
+  cache_entry_c* line = m_victim_cache ? m_victim_cache->find_line(address) : nullptr;
+  if (line) {
+    m_num_coh_invals_recv++;
+    line->m_valid = false;
+    line->m_dirty = false;
+  }
+
+  cache_entry_c* entry = find_entry(address);
+  if (!entry) return;
+
+  m_num_coh_invals_recv++;
+  entry->m_valid = false;
+  entry->m_dirty = false;
+  entry->m_coh_inval = true;
+}
+
+/**
+ * Another core reads the line. A modified copy is written back to L2 and
+ * kept clean in S.
+ */
+void cache_c::downgrade(addr_t address) {
+  cache_entry_c* line = m_victim_cache ? m_victim_cache->find_line(address) : nullptr;
+  cache_entry_c* entry = find_entry(address);
+  if (!entry) entry = line;
+  if (!entry) return;
+
+  m_num_downgrades_recv++;
+  entry->m_shared = true;
+  if (entry->m_dirty) {
+    entry->m_dirty = false;
+    send_wb(create_wb_req(address / m_line_size * m_line_size));
+  }
+}
+
+/**
+ * This delivers a message sent by the shared level in cycle msg.m_cycle. In
+ * serial simulation, the shared level runs after this cache in a cycle, so
+ * the message takes effect m_latency cycles after msg.m_cycle + 1.
+ */
+void cache_c::receive(const link_msg_s& msg) {
+  counter rdy_cycle = msg.m_cycle + 1 + m_latency;
+  if (msg.m_type == LINK_FILL) {
+    m_fill_queue->push(msg.m_req);
+    msg.m_req->m_rdy_cycle = rdy_cycle;
+  } else {
+    m_snoop_queue.push_back(link_msg_s{rdy_cycle, msg.m_type, nullptr, msg.m_addr});
+  }
+}
+
+bool cache_c::is_idle() {
+  return m_in_queue->empty() && m_out_queue->empty() && m_fill_queue->empty() &&
+         m_wb_queue->empty() && m_in_flight_wb_queue->empty() &&
+         m_snoop_queue.empty() && m_pf_in_flight.empty() && m_victim_queue->empty();
+}
+
+/**
+ * Round-robin input arbitration. Every cycle, up to m_num_ports requests are
+ * accepted, one per core in turn, starting from the core after the one that
+ * was served first in the previous cycle. The access latency starts when the
+ * request is accepted.
+ */
+void cache_c::arbitrate() {
+  int num_cores = m_arb_queues.size();
+  int granted = 0;
+  int first = -1;
+
+  for (int ii = 0; ii < num_cores && granted < m_num_ports; ++ii) {
+    int core = (m_arb_next + ii) % num_cores;
+    queue_c* queue = m_arb_queues[core];
+    if (queue->empty()) continue;
+
+    mem_req_s* req = queue->m_entry[0];
+    queue->pop(req);
+    m_core_arb_stalls[core] += m_cycle - req->m_rdy_cycle;
+    req->m_rdy_cycle = m_cycle + m_latency;
+    m_in_queue->push(req);
+
+    if (first == -1) first = core;
+    granted++;
+  }
+
+  if (first != -1) m_arb_next = (first + 1) % num_cores;
 }
 
 /** 
@@ -150,33 +736,84 @@ bool cache_c::access(mem_req_s* req) {
  * 4. on a cache miss, put the current requests into out_queue
  */
 void cache_c::process_in_queue() {
-  while (!m_in_queue->empty()) {
-    mem_req_s * req = m_in_queue->m_entry[0];
-    m_in_queue->pop(req);
+  if (!m_arb_queues.empty()) arbitrate();
 
-    need_writeback = false;
+  // walk by index: pop() erases the entry, and the next one moves into its slot
+  for (size_t ii = 0; ii < m_in_queue->m_entry.size(); /**/) {
+    mem_req_s * req = m_in_queue->m_entry[ii];
 
+    // the outcome is known only after the intrinsic access time
+    if (req->m_rdy_cycle > m_cycle) {
+      ++ii;
+      continue;
+    }
+    m_in_queue->pop(req);
 
     bool hit = cache_base_c::access(req->m_addr, req->m_type, false);
-    if (need_writeback) {
-      req->m_dirty=true;
-      m_wb_queue->push(req);
+    bool is_demand = (req->m_pf_level == 0);
+
+    // MESI: a store to an S line must get ownership from L2 before it is done
+    bool upgrade = false;
+    if (m_coherence && is_top() && hit && req->m_type == REQ_DSTORE) {
+      cache_entry_c* entry = find_entry(req->m_addr);
+      if (entry->m_shared) {
+        entry->m_dirty = false;
+        upgrade = true;
+        m_num_upgrades++;
+      }
     }
-    if (hit) {
-      if (m_level == L1) {
-        done_func(req);
-      } else if (m_level == L2) {
-        if (req->m_type == REQ_DFETCH || req->m_type == REQ_DSTORE) {
-          //data read/write
-          m_prev_d->fill(req);
-        } else {
-          //instruction fetch
-          m_prev_i->fill(req);
+
+    // MESI: a miss to a line invalidated by another core's write is a coherence miss
+    if (m_coherence && is_top() && !hit) {
+      int set_idx = (req->m_addr / m_line_size) % m_num_sets;
+      addr_t tag = req->m_addr / m_line_size / m_num_sets;
+      cache_set_c* set = m_set[set_idx];
+      for (int ii = 0; ii < set->m_assoc; ++ii) {
+        if (!set->m_entry[ii].m_valid && set->m_entry[ii].m_coh_inval && set->m_entry[ii].m_tag == tag) {
+          set->m_entry[ii].m_coh_inval = false;
+          m_num_coh_misses++;
+          break;
         }
       }
+    }
+
+    if (is_demand && m_prev_d.size() > 1) {
+      m_core_accesses[req->m_core_id]++;
+      if (!hit) m_core_misses[req->m_core_id]++;
+    }
+
+    if (is_demand && hit && has_prefetcher()) {
+      cache_entry_c* entry = find_entry(req->m_addr);
+      if (entry->m_prefetch) {
+        entry->m_prefetch = false;
+        m_num_pf_useful++;
+      }
+    }
+
+    auto pf = m_pf_in_flight.end();
+    if (!hit && !m_pf_in_flight.empty()) {
+      pf = m_pf_in_flight.find(req->m_addr / m_line_size * m_line_size);
+    }
+
+    if (pf != m_pf_in_flight.end()) {
+      // the line is already on its way; wait for the prefetch instead
+      pf->second.push_back(req);
+    } else if (hit && !upgrade) {
+      if (is_top()) {
+        done_func(req);
+      } else {
+        if (m_inclusion == INCL_EXCLUSIVE) move_up(req);
+        fill_prev(req);
+      }
+    } else if (!hit && is_demand && m_victim_cache && swap_victim(req)) {
+      // served by the victim cache
     } else {
       m_out_queue->push(req);
     }
+
+    if (is_demand && has_prefetcher()) {
+      train_prefetcher(req, hit);
+    }
   }
 } 
 
@@ -184,17 +821,36 @@ void cache_c::process_in_queue() {
  * This function processes the output queue.
  * The function pops the requests from out_queue and accesses the next-level's cache or main memory.
  * CURRENT: There is no limit on the number of requests we can process in a cycle.
+ * Main memory may refuse a request when its queue is full; the request then
+ * stays at the head and is sent again in the next cycle.
  */
 void cache_c::process_out_queue() {
-    while (!m_out_queue->empty()) {
+  while (!m_mem_wb_queue->empty()) {
+    mem_req_s * req = m_mem_wb_queue->m_entry[0];
+    if (!m_memory->access(req)) break;
+    m_mem_wb_queue->pop(req);
+    m_in_flight_wb_queue->pop(req);
+  }
+
+  while (!m_out_queue->empty()) {
     mem_req_s * req = m_out_queue->m_entry[0];
+    if (m_next == nullptr && (!m_mem_wb_queue->empty() || !m_memory->access(req))) {
+      // stays at the head of the out queue
+      break;
+    }
     m_out_queue->pop(req);
+    if (req->m_type == REQ_WB) {
+      // the next level takes over the in-flight write-back
+      m_in_flight_wb_queue->pop(req);
+    }
+    if (out_func) out_func(req, false);
+
     if (m_next == nullptr) {
-        m_memory->access(req);
-        //i dont think dram calls fill of upper cache! ill do it
-        fill(req);
+      // taken above: main memory fills this cache when the data returns
+    } else if (m_down_link) {
+      m_down_link->push(link_msg_s{m_cycle, (req->m_type == REQ_WB) ? LINK_FILL : LINK_ACCESS, req, 0});
     } else {
-      if (!req->m_dirty) {
+      if (req->m_type != REQ_WB) {
         m_next->access(req);
       }
       else
@@ -205,34 +861,148 @@ void cache_c::process_out_queue() {
 
 /** 
  * This function processes the fill queue.  The fill queue contains both the
- * data from the lower level (and the dirty victim from the upper level. ????) 
+ * data from the lower level and the dirty victims (write-backs) from the
+ * upper level.
  */
 
 void cache_c::process_fill_queue() {
-  while (!m_fill_queue->empty()) {
-    mem_req_s * req = m_fill_queue->m_entry[0];
+  // walk by index: pop() erases the entry, and the next one moves into its slot
+  for (size_t ii = 0; ii < m_fill_queue->m_entry.size(); /**/) {
+    mem_req_s * req = m_fill_queue->m_entry[ii];
+
+    // the line is installed only after the intrinsic access time
+    if (req->m_rdy_cycle > m_cycle) {
+      ++ii;
+      continue;
+    }
     m_fill_queue->pop(req);
-    FILL_TYPE fill_type = req->m_dirty ? FILL_EVICT : FILL_INCLUDE;
-    cache_base_c::access(req->m_addr, fill_type, true);
 
-    if (fill_type == FILL_INCLUDE) {
-      if (m_level == L1) {
-        done_func(req);
-      }
-      else if (m_level == L2) {
-        //since there is a cache above me, need to propatage the include fill upwards
-        if (req->m_type == REQ_DFETCH || req->m_type == REQ_DSTORE) {
-          //data read/write
-          m_prev_d->fill(req);
-        } else {
-          //instruction fetch
-          m_prev_i->fill(req);
-        }
-      }
+    if (req->m_type == REQ_WB) {
+      m_in_flight_wb_queue->pop(req);
+      commit_wb(req);
+    } else {
+      fill_line(req);
     }
   }
 }
 
+/**
+ * A write-back from the previous level updates the line here. If the line
+ * is not here, a NINE/exclusive cache allocates it, and an inclusive cache
+ * (the line was evicted while the write-back was in flight) passes it on.
+ */
+void cache_c::commit_wb(mem_req_s* req) {
+  if (probe(req->m_addr)) {
+    if (req->m_dirty) cache_base_c::access(req->m_addr, FILL_EVICT, true);
+    delete req;
+  } else if (m_inclusion != INCL_INCLUSIVE) {
+    insert_victim(req);
+  } else {
+    send_wb(req);
+  }
+}
+
+/**
+ * This installs the data of a fill and sends it on to the previous level
+ * (or completes the request at the top level).
+ */
+void cache_c::fill_line(mem_req_s* req) {
+  // exclusive: the data goes straight up without a copy here
+  if (m_inclusion == INCL_EXCLUSIVE && req->m_pf_level != m_level) {
+    fill_prev(req);
+    return;
+  }
+
+  // with MESI, a line that is already here (an upgrade, or another core's
+  // miss to the same line) only changes its state
+  cache_entry_c* entry = m_coherence ? find_entry(req->m_addr) : nullptr;
+  if (!entry) {
+    cache_base_c::access(req->m_addr, FILL_INCLUDE, true);
+    entry = find_entry(req->m_addr);
+    entry->m_owner = req->m_core_id;
+    entry->m_coh_inval = false;
+    entry->m_sharers = 0;
+    entry->m_excl = false;
+    entry->m_presence = 0;
+    if (!m_core_lines.empty()) m_core_lines[req->m_core_id]++;
+  }
+  entry->m_prefetch = false;
+  if (m_coherence && is_top()) entry->m_shared = req->m_shared;
+  if (is_top() && req->m_dirty) entry->m_dirty = true;  // moved up from an exclusive level
+
+  if (req->m_pf_level == m_level) {
+    complete_prefetch(req);
+    return;
+  }
+
+  if (is_top()) {
+    // the pending write of a store miss is committed once the line arrives
+    if (req->m_type == REQ_DSTORE && !m_l1_filtered) {
+      entry->m_dirty = true;
+    }
+    if (!m_warming) done_func(req);
+  }
+  else {
+    //since there is a cache above me, need to propatage the include fill upwards
+    fill_prev(req);
+  }
+}
+
+/**
+ * [Functional Warm-up]
+ *
+ * This is process_in_queue() without queues and latencies. A miss goes down
+ * the hierarchy right away, and the line comes back up through fill_line()
+ * in every cache a timed access would fill, with the same replacement,
+ * inclusion, victim cache and MESI state changes. The prefetchers are not
+ * trained, and main memory is not modeled.
+ * @return the level that had the line (the last level + 1: main memory)
+ */
+int cache_c::warm_access(mem_req_s* req) {
+  bool hit = cache_base_c::access(req->m_addr, req->m_type, false);
+
+  // MESI: a store to an S line gets ownership from the next level
+  bool upgrade = false;
+  if (m_coherence && is_top() && hit && req->m_type == REQ_DSTORE) {
+    cache_entry_c* entry = find_entry(req->m_addr);
+    if (entry->m_shared) {
+      entry->m_dirty = false;
+      upgrade = true;
+    }
+  }
+
+  if (hit && !upgrade) {
+    if (!is_top()) {
+      if (m_inclusion == INCL_EXCLUSIVE) move_up(req);
+      fill_prev(req);
+    }
+  } else if (!hit && m_victim_cache && swap_victim(req)) {
+    // served by the victim cache
+  } else if (m_next) {
+    return m_next->warm_access(req);
+  } else {
+    fill_line(req);  // the data comes from main memory
+    return m_level + 1;
+  }
+  return m_level;
+}
+
+/**
+ * This completes the misses that hit in the victim cache once the victim
+ * cache latency has passed.
+ */
+void cache_c::process_victim_queue() {
+  for (size_t ii = 0; ii < m_victim_queue->m_entry.size(); /**/) {
+    mem_req_s * req = m_victim_queue->m_entry[ii];
+    if (req->m_rdy_cycle > m_cycle) {
+      ++ii;
+      continue;
+    }
+    m_victim_queue->pop(req);
+    done_func(req);
+  }
+}
+
 /** 
  * This function processes the write-back queue.
  * The function basically moves the requests from wb_queue to out_queue.
@@ -240,8 +1010,8 @@ void cache_c::process_fill_queue() {
  */
 void cache_c::process_wb_queue() {
   while (!m_wb_queue->empty()) {
-    cout << "process wb queue" << endl;
     mem_req_s * req = m_wb_queue->m_entry[0];
+    DEBUG("[%s] WB %8lx @ %ld\n", m_name.c_str(), req->m_addr, m_cycle);
     m_wb_queue->pop(req);
 
     m_out_queue->push(req);
@@ -249,10 +1019,137 @@ void cache_c::process_wb_queue() {
 }
 
 /**
- * Print statistics (DO NOT CHANGE)
+ * Print statistics: those of cache_base_c, then those of the features this
+ * cache uses (inclusion, prefetcher, MESI, victim cache, sharing by cores).
  */
 void cache_c::print_stats() {
   cache_base_c::print_stats();
   std::cout << "number of back invalidations: " << m_num_backinvals << "\n";
   std::cout << "number of writebacks due to back invalidations: " << m_num_writebacks_backinval << "\n";
+  if (m_inclusion == INCL_EXCLUSIVE) {
+    std::cout << "number of lines moved up: " << m_num_moved_up << "\n";
+  }
+  if (m_inclusion != INCL_INCLUSIVE) {
+    std::cout << "number of victims inserted: " << m_num_victims_inserted << "\n";
+  } else if (!m_uppers.empty()) {
+    std::cout << "number of back invalidation probes: " << m_num_backinval_probes << "\n";
+    std::cout << "number of back invalidation probes skipped: " << m_num_backinval_skipped << "\n";
+  }
+
+  if (has_prefetcher()) {
+    counter covered = m_num_pf_useful + m_num_pf_late;
+    std::cout << "number of prefetches: "        << m_num_pf_issued << "\n";
+    std::cout << "number of useful prefetches: " << m_num_pf_useful << "\n";
+    std::cout << "number of late prefetches: "   << m_num_pf_late << "\n";
+    counter demand = m_num_pf_useful + get_num_misses();
+    std::cout << "prefetch accuracy: "   << (m_num_pf_issued ? (double)covered/m_num_pf_issued*100 : 0) << " % \n";
+    std::cout << "prefetch coverage: "   << (demand ? (double)covered/demand*100 : 0) << " % \n";
+    std::cout << "prefetch timeliness: " << (covered ? (double)m_num_pf_useful/covered*100 : 0) << " % \n";
+    if (m_prefetcher) m_prefetcher->print_stats();
+    if (m_inst_prefetcher) m_inst_prefetcher->print_stats();
+  }
+
+  if (m_coherence && is_top()) {
+    std::cout << "number of coherence misses: "          << m_num_coh_misses << "\n";
+    std::cout << "number of upgrades: "                  << m_num_upgrades << "\n";
+    std::cout << "number of invalidations received: "    << m_num_coh_invals_recv << "\n";
+    std::cout << "number of downgrades received: "       << m_num_downgrades_recv << "\n";
+  } else if (m_coherence) {
+    std::cout << "number of invalidations sent: "        << m_num_coh_invals_sent << "\n";
+    std::cout << "number of downgrades sent: "           << m_num_downgrades_sent << "\n";
+    std::cout << "number of invalidations filtered by the directory: " << m_num_invals_filtered << "\n";
+  }
+
+  if (m_victim_cache) {
+    std::cout << "number of next-level round trips saved by the victim cache: " << m_num_trips_saved << "\n";
+  }
+
+  // per-core share of a cache shared by several cores
+  int num_cores = m_prev_d.size();
+  if (num_cores > 1) {
+    double num_lines = (double)m_num_sets * m_set[0]->m_assoc;
+
+    for (int core = 0; core < num_cores; ++core) {
+      std::cout << "core " << core << " number of accesses: " << m_core_accesses[core] << "\n";
+      std::cout << "core " << core << " number of misses: " << m_core_misses[core] << "\n";
+      std::cout << "core " << core << " miss rate: "
+                << (m_core_accesses[core] ? (double)m_core_misses[core]/m_core_accesses[core]*100 : 0) << " % \n";
+      std::cout << "core " << core << " average occupancy: "
+                << (m_cycle ? (double)m_core_line_cycles[core]/m_cycle/num_lines*100 : 0) << " % \n";
+      std::cout << "core " << core << " final occupancy: " << m_core_lines[core] << " lines\n";
+      std::cout << "core " << core << " input arbitration stall cycles: " << m_core_arb_stalls[core] << "\n";
+    }
+  }
+
+  if (m_victim_cache) m_victim_cache->print_stats();
+}
+
+/**
+ * A checkpoint is taken on an idle hierarchy, so the queues are empty and
+ * only the contents of the cache (and of its victim cache) are kept.
+ */
+void cache_c::save_state(std::ostream& out) {
+  cache_base_c::save_state(out);
+
+  uint32_t num_cores = m_core_lines.size();
+  out.write((const char*)&num_cores, sizeof(num_cores));
+  out.write((const char*)m_core_lines.data(), num_cores * sizeof(counter));
+
+  uint32_t has_victim_cache = (m_victim_cache != nullptr);
+  out.write((const char*)&has_victim_cache, sizeof(has_victim_cache));
+  if (m_victim_cache) m_victim_cache->save_state(out);
+}
+
+const char* cache_c::load_state(const char* data, const char* end) {
+  data = cache_base_c::load_state(data, end);
+  if (!data || end - data < (long)sizeof(uint32_t)) return nullptr;
+
+  uint32_t num_cores;
+  memcpy(&num_cores, data, sizeof(num_cores));
+  data += sizeof(num_cores);
+  if (num_cores != m_core_lines.size() || end - data < (long)(num_cores * sizeof(counter) + sizeof(uint32_t)))
+    return nullptr;
+  memcpy(m_core_lines.data(), data, num_cores * sizeof(counter));
+  data += num_cores * sizeof(counter);
+
+  uint32_t has_victim_cache;
+  memcpy(&has_victim_cache, data, sizeof(has_victim_cache));
+  data += sizeof(has_victim_cache);
+  if (has_victim_cache != (m_victim_cache != nullptr)) return nullptr;
+  if (m_victim_cache) data = m_victim_cache->load_state(data, end);
+  return data;
+}
+
+/**
+ * This clears the statistics (e.g., at the end of a fast-forward). The
+ * cache contents and the per-core line counts are kept.
+ */
+void cache_c::reset_stats() {
+  cache_base_c::reset_stats();
+  m_num_backinvals = 0;
+  m_num_writebacks_backinval = 0;
+  m_num_backinval_probes = 0;
+  m_num_backinval_skipped = 0;
+  m_num_victims_inserted = 0;
+  m_num_moved_up = 0;
+
+  std::fill(m_core_accesses.begin(), m_core_accesses.end(), 0);
+  std::fill(m_core_misses.begin(), m_core_misses.end(), 0);
+  std::fill(m_core_arb_stalls.begin(), m_core_arb_stalls.end(), 0);
+  std::fill(m_core_line_cycles.begin(), m_core_line_cycles.end(), 0);
+
+  m_num_coh_misses = 0;
+  m_num_upgrades = 0;
+  m_num_coh_invals_recv = 0;
+  m_num_downgrades_recv = 0;
+  m_num_coh_invals_sent = 0;
+  m_num_downgrades_sent = 0;
+  m_num_invals_filtered = 0;
+
+  m_num_pf_issued = 0;
+  m_num_pf_useful = 0;
+  m_num_pf_late = 0;
+
+  m_num_trips_saved = 0;
+  if (m_victim_cache) m_victim_cache->reset_stats();
 }
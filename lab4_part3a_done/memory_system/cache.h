@@ -10,26 +10,62 @@
 #include "./cache_base/cache_base.h"
 #include "memory_controller/simple_mem.h"
 #include "memory_hierarchy.h"
+#include "mem_link.h"
+#include "prefetcher.h"
+#include "victim_cache.h"
 
 #include <cstring>
 #include <functional>
+#include <unordered_map>
+#include <vector>
 
 // forward declaration
 class simple_mem_c;
 class memory_hierarchy_c;
 
+enum INCLUSION_POLICY {
+  INCL_INCLUSIVE = 0,  ///< every line above is also here (back-invalidation on eviction)
+  INCL_NINE,           ///< non-inclusive non-exclusive: no back-invalidation
+  INCL_EXCLUSIVE       ///< a line is either here or above: hits move up, victims come down
+};
 
 class cache_c : public cache_base_c {
 
 public:
   cache_c(std::string name, int level, int num_set, int assoc, int line_size, int latency);
   void configure_neighbors(cache_c* prev_i, cache_c* prev_d, cache_c* next, simple_mem_c* memory);
+  void configure_neighbors(const std::vector<cache_c*>& prev_i, const std::vector<cache_c*>& prev_d,
+                           cache_c* next, simple_mem_c* memory);  ///< one prev_i/prev_d per core
+  void set_input_ports(int num_ports) { m_num_ports = num_ports; }
+  void set_down_link(link_c* link) { m_down_link = link; }
+  void set_up_links(const std::vector<link_c*>& links) { m_up_links = links; }
+  void receive(const link_msg_s& msg);      ///< deliver a message from the shared level
+  void queue_snoop(addr_t addr, int type);  ///< back-invalidate/invalidate/downgrade after the access latency
+  void set_core_id(int core_id) { m_core_id = core_id; }
+  void set_coherence() { m_coherence = true; }  ///< MESI among the private L1s
+  void evict_notify(addr_t addr, int cache);  ///< upper-level cache with presence bit "cache" dropped the line
+  void set_inclusion(int policy) { m_inclusion = policy; }  ///< INCLUSION_POLICY towards the previous level
+  int get_num_backinvals() const { return m_num_backinvals; }
+  int get_presence_bit() const { return m_presence_bit; }
+  bool is_idle();                           ///< nothing queued or in flight
+  counter get_cycle() const { return m_cycle; }
+  void set_prefetcher(prefetcher_c* prefetcher) { m_prefetcher = prefetcher; }
+  void set_inst_prefetcher(prefetcher_c* prefetcher) { m_inst_prefetcher = prefetcher; }
+  void set_victim_cache(victim_cache_c* victim_cache) { m_victim_cache = victim_cache; }  ///< top level only
   void run_a_cycle();             ///< tick a cycle
                                   
   bool access(mem_req_s*);        ///< insert a request into in_queue
+  int  access_batch(mem_req_s* const* reqs, int num);  ///< requests of a core sent in the same cycle; how many fit
   bool fill(mem_req_s*);          ///< insert a request into fill_queue
+
+  // functional warm-up (fast-forward): no queues and no time
+  void set_warming(bool warming) { m_warming = warming; }
+  int  warm_access(mem_req_s* req);  ///< the line ends up where a timed access would put it; the level that served it
   
   void print_stats(void);
+  void reset_stats(void);
+  void save_state(std::ostream& out);  ///< tag store, victim cache and line counts (checkpoint)
+  const char* load_state(const char* data, const char* end);
 
   // callback for done requests
 public:
@@ -38,6 +74,13 @@ public:
   callback_t done_func;              
   void set_done_func(callback_t cb) { done_func = std::move(cb); }
 
+  // callback for the requests that leave the cache (L1 filter); to_memory: a write-back straight to memory
+  using out_callback_t = std::function<void(mem_req_s*, bool to_memory)>;
+
+  out_callback_t out_func;
+  void set_out_func(out_callback_t cb) { out_func = std::move(cb); }
+  void set_l1_filtered() { m_l1_filtered = true; }  ///< top level fed by an L1-filtered trace
+
   static const int L1 = 1;
   static const int L2 = 2;
 
@@ -46,6 +89,31 @@ private:
   void process_out_queue();       ///< process requests from out_queue
   void process_fill_queue();      ///< process requests from fill_queue
   void process_wb_queue();        ///< process requests from wb_queue
+  void arbitrate();               ///< move requests from the per-core input queues to in_queue
+  void process_snoop_queue();     ///< apply back-invalidations/invalidations/downgrades that became ready
+  void process_victim_queue();    ///< complete the misses served by the victim cache
+  void fill_prev(mem_req_s* req); ///< send data to the requesting core's cache
+  void send_to_memory(mem_req_s* req);  ///< write-back straight to main memory
+  void send_snoop(int core, int type, addr_t addr);  ///< message to a core's L1 (LINK_MSG_TYPE)
+  void move_up(mem_req_s* req);         ///< exclusive: drop the line sent to the previous level
+  void insert_victim(mem_req_s* req);   ///< NINE/exclusive: allocate a previous-level victim
+  bool swap_victim(mem_req_s* req);     ///< a miss that hits in the victim cache
+  bool holds(addr_t addr);              ///< the line is here or in the victim cache
+  void fill_line(mem_req_s* req);       ///< install the data of a fill and pass it up
+  void commit_wb(mem_req_s* req);       ///< a write-back from the previous level
+  void send_wb(mem_req_s* wb);          ///< write-back of a victim to the next level
+  void snoop(int type, addr_t addr);    ///< apply a LINK_INVAL/LINK_COH_INVAL/LINK_DOWNGRADE
+
+  // MESI
+  void coherence_request(cache_entry_c* entry, mem_req_s* req);  ///< directory (L2): grant a line to a core
+  void coherence_invalidate(addr_t addr);  ///< L1: another core writes the line
+  void downgrade(addr_t addr);             ///< L1: another core reads the line (E/M -> S)
+
+  void train_prefetcher(mem_req_s* req, bool hit);  ///< notify the prefetcher and issue prefetches
+  void complete_prefetch(mem_req_s* req);           ///< a prefetch issued here has filled
+  bool has_prefetcher() const { return m_prefetcher || m_inst_prefetcher; }
+  bool is_top() const { return m_prev_d.empty(); }  ///< no previous level: requests come from a core
+  void invalidate_uppers(uint64_t presence, addr_t addr);  ///< back-invalidate the previous-level holders
 
 public:
   queue_c* m_in_flight_wb_queue;  ///< in-flight write-back queue
@@ -54,31 +122,86 @@ private:
   memory_hierarchy_c* m_mm;
 
   int m_id;                       ///< cache id
-  int m_level;                    ///< cache level (L1, L2) 
+  int m_level;                    ///< cache level (1: L1, 2: L2, ...)
   int m_latency;                  ///< cache hit latency (intrinsic access time)
   
   queue_c* m_in_queue;            ///< input queue 
   queue_c* m_out_queue;           ///< out queue 
   queue_c* m_fill_queue;          ///< fill queue 
   queue_c* m_wb_queue;            ///< write-back queue
+  queue_c* m_mem_wb_queue;        ///< write-backs straight to memory that it could not take yet
 
   counter m_cycle;                ///< clock cycle                         
 
-  cache_c* m_prev_i;              ///< previous I-cache level pointer
-  cache_c* m_prev_d;              ///< previous D-cache level pointer
+  std::vector<cache_c*> m_prev_i; ///< previous I-cache level pointer (per core)
+  std::vector<cache_c*> m_prev_d; ///< previous D-cache level pointer (per core)
   cache_c* m_next;                ///< next cache level potiner
+  std::vector<cache_c*> m_uppers; ///< distinct previous-level caches; index = presence bit
+  std::vector<int> m_upper_core;  ///< core of each previous-level cache
+  int m_presence_bit;             ///< this cache's presence bit at the next level
+  int m_inclusion;                ///< INCLUSION_POLICY towards the previous level
+  counter m_num_victims_inserted; ///< # previous-level victims allocated here (NINE/exclusive)
+  counter m_num_moved_up;         ///< # hits whose line moved to the previous level (exclusive)
   simple_mem_c* m_memory;         ///< main memory pointer
   
   int m_num_backinvals;                ///< # of back-invalidations
   int m_num_writebacks_backinval;      ///< # of writebacks due to back-invalidation
+  counter m_num_backinval_probes;      ///< # back-invalidations sent to a holder of the victim
+  counter m_num_backinval_skipped;     ///< # previous-level caches not probed (presence bit clear)
+
+  // input arbitration among the cores (only with more than one previous-level cache)
+  std::vector<queue_c*> m_arb_queues;  ///< per-core requests waiting for an input port
+  int m_arb_next;                      ///< core with the highest priority in the next cycle
+  int m_num_ports;                     ///< # requests accepted per cycle
+
+  std::vector<counter> m_core_accesses;    ///< # demand accesses per core
+  std::vector<counter> m_core_misses;      ///< # demand misses per core
+  std::vector<counter> m_core_arb_stalls;  ///< # cycles requests of each core waited for a port
+  std::vector<counter> m_core_lines;       ///< # lines each core currently occupies
+  std::vector<counter> m_core_line_cycles; ///< m_core_lines summed over cycles (average occupancy)
+
+  // multi-core: back-invalidations take the access latency to reach this cache
+  std::vector<link_msg_s> m_snoop_queue;  ///< messages from the shared level; m_cycle is the ready cycle
+
+  // MESI among the private L1s; the directory is kept in the (inclusive) L2 entries
+  bool m_coherence;                    ///< MESI on
+  int m_core_id;                       ///< L1: core that owns this cache
+  counter m_num_coh_misses;            ///< L1: misses to lines invalidated by another core's write
+  counter m_num_upgrades;              ///< L1: stores to S lines (ownership requests)
+  counter m_num_coh_invals_recv;       ///< L1: invalidations received
+  counter m_num_downgrades_recv;       ///< L1: downgrades received
+  counter m_num_coh_invals_sent;       ///< L2: invalidations sent to sharers
+  counter m_num_downgrades_sent;       ///< L2: downgrades sent to owners
+  counter m_num_invals_filtered;       ///< L2: cores not probed on a write thanks to the directory
+
+  // parallel simulation: traffic between a core's L1 and the shared levels
+  link_c* m_down_link;                 ///< L1 -> shared levels (nullptr: direct calls)
+  std::vector<link_c*> m_up_links;     ///< shared level -> each core's L1 (empty: direct calls)
+
+  prefetcher_c* m_prefetcher;          ///< prefetcher (nullptr: demand fetch only)
+  prefetcher_c* m_inst_prefetcher;     ///< instruction-side prefetcher; sees REQ_IFETCH only
+  std::unordered_map<addr_t, std::vector<mem_req_s*> > m_pf_in_flight;  ///< line -> demand requests waiting on it
+
+  counter m_num_pf_issued;             ///< # prefetches sent to the next level
+  counter m_num_pf_useful;             ///< # prefetched lines referenced by a demand access
+  counter m_num_pf_late;               ///< # demand misses to a line still being prefetched
+
+  bool m_warming;                      ///< functional warm-up: every effect is immediate
+  bool m_l1_filtered;                  ///< the requests are L1 misses: a store miss dirties the L1's copy, not this one
+
+  victim_cache_c* m_victim_cache;      ///< victim cache of an L1 (nullptr: none)
+  queue_c* m_victim_queue;             ///< misses served by the victim cache, until its latency has passed
+  counter m_num_trips_saved;           ///< # misses served by the victim cache without a next-level access
 
 public:
   cache_c();               // no need to implement
   ~cache_c();
 
 protected:
-  bool evict_and_bring_new(int set_idx, int tag, int req_type, bool set_dirty);
+  bool evict_and_bring_new(int set_idx, addr_t tag, int req_type, bool set_dirty);
   void back_invalidate(addr_t addr);
+  mem_req_s* create_wb_req(addr_t addr);  ///< new write-back request for a dirty victim
+  mem_req_s* create_pf_req(addr_t addr, int type);  ///< new prefetch request
 };
 
 #endif // !__CACHE_H__
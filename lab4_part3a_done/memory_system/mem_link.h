@@ -0,0 +1,32 @@
+// ECE 430.322: Computer Organization
+// Lab 4: Memory System Simulation
+
+#ifndef __MEM_LINK_H__
+#define __MEM_LINK_H__
+
+#include "atom/global.h"
+#include "atom/mem_req.h"
+#include "atom/spsc_queue.h"
+
+enum LINK_MSG_TYPE {
+  LINK_ACCESS = 0,   ///< L1 -> L2: access (miss or prefetch)
+  LINK_FILL,         ///< L1 -> L2: write-back; L2 -> L1: data fill
+  LINK_MEM,          ///< L1 -> main memory: write-back of a back-invalidated line
+  LINK_INVAL,        ///< L2 -> L1: back-invalidation
+  LINK_COH_INVAL,    ///< L2 -> L1: MESI invalidation (another core writes the line)
+  LINK_DOWNGRADE,    ///< L2 -> L1: MESI downgrade to S (another core reads the line)
+  LINK_EVICT         ///< L1 -> L2: the L1 no longer holds the line
+};
+
+/// message between a core's L1 and the shared levels in parallel simulation
+struct link_msg_s {
+  counter    m_cycle;  ///< sender's cycle
+  int        m_type;   ///< LINK_MSG_TYPE
+  mem_req_s* m_req;
+  addr_t     m_addr;   ///< line address (invalidations, downgrades, and evictions)
+  int        m_cache;  ///< presence bit of the L1 the message is from/to (-1: all the L1s of the core)
+};
+
+using link_c = spsc_queue_c<link_msg_s>;
+
+#endif // !__MEM_LINK_H__
@@ -0,0 +1,216 @@
+// ECE 430.322: Computer Organization
+// Lab 4: Memory System Simulation
+
+#include "dram_ctrl.h"
+
+#include <algorithm>
+#include <cassert>
+
+dram_ctrl_c::dram_ctrl_c(const std::string& name, int level, const config_c& config, int line_size)
+    : simple_mem_c(name, level, 0) {
+
+  m_num_channels = config.get_dram_channels();
+  m_num_ranks    = config.get_dram_ranks();
+  m_num_banks    = config.get_dram_banks();
+  m_line_size    = line_size;
+  m_num_columns  = config.get_dram_row_size() / line_size;
+  m_addr_map     = config.get_dram_addr_map();
+  m_page_policy  = config.get_dram_page_policy();
+
+  m_tRCD   = config.get_dram_tRCD();
+  m_tCAS   = config.get_dram_tCAS();
+  m_tRP    = config.get_dram_tRP();
+  m_tBURST = config.get_dram_tBURST();
+
+  m_wq_high = config.get_dram_wq_high();
+  m_wq_low  = config.get_dram_wq_low();
+  m_queue_size = config.get_dram_queue_size();
+
+  assert(m_num_channels > 0 && m_num_ranks > 0 && m_num_banks > 0 && m_num_columns > 0);
+  assert(m_wq_low < m_wq_high && "low watermark must be below the high watermark");
+  assert((m_queue_size == 0 || m_wq_high <= m_queue_size) && "the write queue must reach the high watermark");
+
+  m_channels.resize(m_num_channels);
+  for (auto& channel : m_channels) {
+    channel.m_banks.assign(m_num_ranks * m_num_banks, bank_s{-1, 0});
+    channel.m_bus_free_cycle = 0;
+    channel.m_draining = false;
+  }
+  m_shadow_channels = m_channels;
+
+  m_num_row_hits = 0;
+  m_num_row_misses = 0;
+  m_num_row_conflicts = 0;
+  m_total_read_latency = 0;
+  m_total_read_latency_no_wr = 0;
+  m_num_drains = 0;
+  m_num_drain_writes = 0;
+  m_bus_busy_cycles = 0;
+  m_num_rejects = 0;
+}
+
+dram_ctrl_c::~dram_ctrl_c() {
+}
+
+/**
+ * Tick a cycle for the DRAM controller.
+ * Data that returned in the previous cycles goes back first, then every
+ * channel issues at most one request, and finally the requests whose data
+ * transfer ends in this cycle are completed.
+ */
+void dram_ctrl_c::run_a_cycle() {
+  process_out_queue();
+
+  for (auto& channel : m_channels) {
+    schedule(channel, false);
+  }
+  for (auto& channel : m_shadow_channels) {
+    schedule(channel, true);
+  }
+
+  process_in_queue();
+
+  ++m_cycle;
+}
+
+/**
+ * This decodes the address into channel/rank/bank/row and queues the request
+ * at its channel.
+ * @return false if the queue of the channel is full (the request is not taken)
+ */
+bool dram_ctrl_c::access(mem_req_s* req) {
+  addr_t line = req->m_addr / m_line_size;
+  int channel, rank, bank;
+  int64_t row;
+
+  if (m_addr_map == ADDR_MAP_ROW_COL_BANK) {
+    channel = line % m_num_channels;  line /= m_num_channels;
+    bank    = line % m_num_banks;     line /= m_num_banks;
+    rank    = line % m_num_ranks;     line /= m_num_ranks;
+    line   /= m_num_columns;
+    row     = line;
+  } else {
+    line   /= m_num_columns;
+    channel = line % m_num_channels;  line /= m_num_channels;
+    bank    = line % m_num_banks;     line /= m_num_banks;
+    rank    = line % m_num_ranks;     line /= m_num_ranks;
+    row     = line;
+  }
+
+  std::vector<dram_req_s>& queue = (req->m_type == REQ_WB) ? m_channels[channel].m_write_queue
+                                                           : m_channels[channel].m_read_queue;
+  if (m_queue_size && queue.size() >= m_queue_size) {
+    m_num_rejects++;
+    return false;
+  }
+
+  if (req->m_type == REQ_WB) {
+    m_in_flight_wb_queue->push(req);
+    m_num_writes++;
+  } else {
+    m_num_reads++;
+  }
+
+  dram_req_s dram_req = {req, m_cycle, rank, bank, row};
+  queue.push_back(dram_req);
+  if (req->m_type != REQ_WB) {
+    m_shadow_channels[channel].m_read_queue.push_back(dram_req);
+  }
+  return true;
+}
+
+/**
+ * FR-FCFS scheduling. The channel first decides whether it serves reads or
+ * drains writes. Then, among the requests whose bank is ready, the oldest
+ * row-buffer hit is picked first; if there is none, the oldest one is picked.
+ * The shadow channels only see reads and just account the read latency.
+ */
+void dram_ctrl_c::schedule(channel_s& channel, bool is_shadow) {
+  if (!channel.m_draining && channel.m_write_queue.size() >= m_wq_high) {
+    channel.m_draining = true;
+    m_num_drains++;
+  } else if (channel.m_draining && channel.m_write_queue.size() <= m_wq_low) {
+    channel.m_draining = false;
+  }
+
+  bool serve_writes = channel.m_draining || channel.m_read_queue.empty();
+  std::vector<dram_req_s>& queue = serve_writes ? channel.m_write_queue : channel.m_read_queue;
+  auto pick = queue.end();
+
+  for (auto it = queue.begin(); it != queue.end(); ++it) {
+    bank_s& bank = channel.m_banks[it->m_rank * m_num_banks + it->m_bank];
+    if (bank.m_ready_cycle > m_cycle) continue;
+
+    if (bank.m_open_row == it->m_row) {
+      pick = it;
+      break;
+    }
+    if (pick == queue.end()) pick = it;
+  }
+
+  if (pick == queue.end()) return;
+
+  bank_s& bank = channel.m_banks[pick->m_rank * m_num_banks + pick->m_bank];
+  int latency;
+  if (bank.m_open_row == pick->m_row) {
+    latency = m_tCAS;
+    if (!is_shadow) m_num_row_hits++;
+  } else if (bank.m_open_row == -1) {
+    latency = m_tRCD + m_tCAS;
+    if (!is_shadow) m_num_row_misses++;
+  } else {
+    latency = m_tRP + m_tRCD + m_tCAS;
+    if (!is_shadow) m_num_row_conflicts++;
+  }
+
+  counter data_start = std::max(m_cycle + latency, channel.m_bus_free_cycle);
+  counter done_cycle = data_start + m_tBURST;
+  channel.m_bus_free_cycle = done_cycle;
+
+  if (m_page_policy == PAGE_CLOSED) {
+    bank.m_open_row = -1;
+    bank.m_ready_cycle = done_cycle + m_tRP;
+  } else {
+    bank.m_open_row = pick->m_row;
+    bank.m_ready_cycle = done_cycle;
+  }
+
+  mem_req_s* req = pick->m_req;
+  counter latency_total = done_cycle - pick->m_arrival_cycle;
+  queue.erase(pick);
+
+  if (is_shadow) {
+    m_total_read_latency_no_wr += latency_total;
+    return;
+  }
+
+  m_bus_busy_cycles += m_tBURST;
+  if (req->m_type != REQ_WB) {
+    m_total_read_latency += latency_total;
+  } else if (channel.m_draining) {
+    m_num_drain_writes++;
+  }
+  schedule_done(req, done_cycle);
+}
+
+/**
+ * Print statistics
+ */
+void dram_ctrl_c::print_stats() {
+  counter num_accesses = m_num_row_hits + m_num_row_misses + m_num_row_conflicts;
+
+  simple_mem_c::print_stats();
+  std::cout << "row hit rate: "            << (num_accesses ? (double)m_num_row_hits/num_accesses*100 : 0) << " % \n";
+  std::cout << "number of row hits: "      << m_num_row_hits << "\n";
+  std::cout << "number of row misses: "    << m_num_row_misses << "\n";
+  std::cout << "number of row conflicts: " << m_num_row_conflicts << "\n";
+  std::cout << "average read latency: "    << (m_num_reads ? (double)m_total_read_latency/m_num_reads : 0) << "\n";
+  std::cout << "average read latency without write interference: "
+            << (m_num_reads ? (double)m_total_read_latency_no_wr/m_num_reads : 0) << "\n";
+  std::cout << "number of write drains: "  << m_num_drains << "\n";
+  std::cout << "number of writes issued in drains: " << m_num_drain_writes << "\n";
+  std::cout << "bandwidth (bytes/cycle): " << (m_cycle ? (double)num_accesses*m_line_size/m_cycle : 0) << "\n";
+  std::cout << "number of requests refused by a full queue: " << m_num_rejects << "\n";
+  std::cout << "data bus utilization: "
+            << (m_cycle ? (double)m_bus_busy_cycles/((double)m_cycle*m_num_channels)*100 : 0) << " % \n";
+}
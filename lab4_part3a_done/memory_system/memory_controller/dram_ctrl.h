@@ -0,0 +1,108 @@
+// ECE 430.322: Computer Organization
+// Lab 4: Memory System Simulation
+
+#ifndef __DRAM_CTRL_H__
+#define __DRAM_CTRL_H__
+
+#include "simple_mem.h"
+#include "config.h"
+
+#include <vector>
+
+enum DRAM_ADDR_MAP {
+  ADDR_MAP_ROW_BANK_COL = 0,    ///< row:rank:bank:channel:column (row locality)
+  ADDR_MAP_ROW_COL_BANK         ///< row:column:rank:bank:channel (line interleaving)
+};
+
+enum DRAM_PAGE_POLICY {
+  PAGE_OPEN = 0,                ///< keep the row open after an access
+  PAGE_CLOSED                   ///< precharge the row after every access
+};
+
+/***
+ *
+ * @class DRAM controller (dram_ctrl_c)
+ *
+ * This models a banked DRAM behind a memory controller. Requests are queued
+ * per channel and scheduled with FR-FCFS: the oldest row-buffer hit to a ready
+ * bank goes first, otherwise the oldest request to a ready bank. The access
+ * latency depends on the row-buffer state (tCAS on a hit, tRCD + tCAS on a
+ * closed row, tRP + tRCD + tCAS on a conflict), and the data bus of each
+ * channel is occupied for tBURST cycles per request.
+ *
+ * Write-backs wait in a separate write queue. Reads have priority until the
+ * write queue reaches the high watermark; the channel then drains writes in a
+ * burst until the queue falls to the low watermark. Writes are also issued
+ * whenever there is no read to serve. To measure the cost of writes, every
+ * read is replayed on a read-only shadow of the channels, which gives the
+ * read latency without write interference.
+ *
+ * Both queues of a channel hold at most dram_queue_size requests. A request
+ * to a full queue is refused (access() returns false), and the sender keeps
+ * it and retries in a later cycle.
+ */
+class dram_ctrl_c : public simple_mem_c {
+public:
+  dram_ctrl_c(const std::string& name, int level, const config_c& config, int line_size);
+  ~dram_ctrl_c();
+
+  void run_a_cycle() override;
+  bool access(mem_req_s* req) override;
+  void print_stats() override;
+
+private:
+  struct dram_req_s {
+    mem_req_s* m_req;
+    counter m_arrival_cycle;    ///< cycle when the request entered the controller
+    int m_rank;
+    int m_bank;
+    int64_t m_row;
+  };
+
+  struct bank_s {
+    int64_t m_open_row;         ///< currently open row (-1: precharged)
+    counter m_ready_cycle;      ///< cycle when the bank can take a new command
+  };
+
+  struct channel_s {
+    std::vector<dram_req_s> m_read_queue;   ///< pending reads in arrival order
+    std::vector<dram_req_s> m_write_queue;  ///< pending write-backs in arrival order
+    std::vector<bank_s> m_banks;            ///< ranks * banks
+    counter m_bus_free_cycle;               ///< cycle when the data bus is free
+    bool m_draining;                        ///< draining writes down to the low watermark
+  };
+
+  void schedule(channel_s& channel, bool is_shadow);  ///< FR-FCFS: issue at most one request
+
+  std::vector<channel_s> m_channels;
+  std::vector<channel_s> m_shadow_channels;  ///< read-only replay (no write interference)
+
+  int m_num_channels;
+  int m_num_ranks;
+  int m_num_banks;
+  int m_num_columns;            ///< cache lines per row
+  int m_line_size;
+  int m_addr_map;
+  int m_page_policy;
+
+  int m_tRCD;
+  int m_tCAS;
+  int m_tRP;
+  int m_tBURST;
+
+  unsigned int m_wq_high;       ///< write queue high watermark (start draining)
+  unsigned int m_wq_low;        ///< write queue low watermark (stop draining)
+  unsigned int m_queue_size;    ///< read/write queue entries per channel (0: unbounded)
+
+  counter m_num_row_hits;       ///< # accesses to the open row
+  counter m_num_row_misses;     ///< # accesses to a precharged bank
+  counter m_num_row_conflicts;  ///< # accesses that had to close another row
+  counter m_total_read_latency; ///< sum of read latencies (arrival to data)
+  counter m_total_read_latency_no_wr;  ///< same on the read-only shadow channels
+  counter m_num_drains;         ///< # write drain bursts
+  counter m_num_drain_writes;   ///< # writes issued while draining
+  counter m_bus_busy_cycles;    ///< # cycles the data buses transferred data
+  counter m_num_rejects;        ///< # requests refused by a full queue (retried by the sender)
+};
+
+#endif // !__DRAM_CTRL_H__
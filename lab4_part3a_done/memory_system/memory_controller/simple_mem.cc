@@ -0,0 +1,137 @@
+// ECE 430.322: Computer Organization
+// Lab 4: Memory System Simulation
+
+/**
+ *
+ * @class simple_mem_c
+ *
+ * This models main memory with a fixed access latency. Every request that
+ * arrives through access() completes exactly "latency" cycles later. Instead
+ * of scanning all the pending requests every cycle, the in-queue is a min-heap
+ * keyed on the completion cycle, so a cycle only touches the requests that
+ * actually complete in it.
+ */
+
+#include "simple_mem.h"
+
+#include <cassert>
+
+simple_mem_c::simple_mem_c(const std::string& name, int level, uint32_t latency) {
+  m_name = name;
+  m_latency = latency;
+  m_level = level;
+  m_cycle = 0;
+  m_seq = 0;
+  m_prev = nullptr;
+  m_prev_i = nullptr;
+
+  m_num_reads = 0;
+  m_num_writes = 0;
+
+  m_out_queue = new queue_c();
+  m_in_flight_wb_queue = new queue_c();
+}
+
+simple_mem_c::~simple_mem_c() {
+  delete m_out_queue;
+  delete m_in_flight_wb_queue;
+}
+
+void simple_mem_c::configure_neighbors(cache_c* prev) {
+  m_prev = prev;
+  m_prev_i = prev;
+}
+
+void simple_mem_c::configure_neighbors(cache_c* prev_i, cache_c* prev_d) {
+  m_prev = prev_d;
+  m_prev_i = prev_i;
+}
+
+/**
+ * Tick a cycle for main memory.
+ * Requests that completed in the previous cycle are returned first, and then
+ * the requests that complete in this cycle are moved to out_queue.
+ */
+void simple_mem_c::run_a_cycle() {
+  process_out_queue();
+
+  process_in_queue();
+
+  ++m_cycle;
+}
+
+/**
+ * This accepts a new request. The request is done after the memory latency.
+ * Write-backs are also tracked in the in-flight write-back queue until they
+ * are committed to memory.
+ */
+bool simple_mem_c::access(mem_req_s* req) {
+  if (req->m_type == REQ_WB) {
+    m_in_flight_wb_queue->push(req);
+    m_num_writes++;
+  } else {
+    m_num_reads++;
+  }
+
+  schedule_done(req, m_cycle + m_latency);
+  return true;
+}
+
+/**
+ * This puts the request into the in-queue so that it is done at done_cycle.
+ */
+void simple_mem_c::schedule_done(mem_req_s* req, counter done_cycle) {
+  req->m_rdy_cycle = done_cycle;
+  m_in_queue.push({done_cycle, m_seq++, req});
+}
+
+/**
+ * This pops the requests whose completion cycle has been reached. Reads move
+ * to out_queue to return the data; write-backs are committed and freed here.
+ */
+void simple_mem_c::process_in_queue() {
+  while (!m_in_queue.empty() && m_in_queue.top().m_rdy_cycle <= m_cycle) {
+    mem_req_s* req = m_in_queue.top().m_req;
+
+    if (req->m_type != REQ_WB && !m_out_queue->push(req)) break;
+    m_in_queue.pop();
+
+    if (req->m_type == REQ_WB) {
+      m_in_flight_wb_queue->pop(req);
+      delete req;
+    }
+  }
+}
+
+/**
+ * This returns the data to the previous level. When main memory is the
+ * top-level component (i.e., DRAM only), the request is done.
+ */
+void simple_mem_c::process_out_queue() {
+  std::list<mem_req_s*> done_list;
+
+  for (auto req : m_out_queue->m_entry) {
+    cache_c* prev = (req->m_type == REQ_IFETCH) ? m_prev_i : m_prev;
+    if (prev == nullptr) {
+      done_func(req);
+    } else if (!prev->fill(req)) {
+      break;
+    }
+    done_list.push_back(req);
+  }
+
+  for (auto req : done_list) {
+    m_out_queue->pop(req);
+  }
+}
+
+/**
+ * Print statistics
+ */
+void simple_mem_c::print_stats() {
+  std::cout << "------------------------------" << "\n";
+  std::cout << m_name << " Stats" << "\n";
+  std::cout << "------------------------------" << "\n";
+  std::cout << "number of reads: "      << m_num_reads << "\n";
+  std::cout << "number of writes: "     << m_num_writes << "\n";
+}
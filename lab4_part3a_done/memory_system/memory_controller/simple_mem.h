@@ -14,42 +14,65 @@
 #include <iostream>
 #include <functional>
 #include <list>
+#include <queue>
 
 // forward declaration
-class cache_c;  
+class cache_c;
 class queue_c;
 
 class simple_mem_c {
 public:
   simple_mem_c(const std::string& name, int level, uint32_t latency);
-  ~simple_mem_c();
-                          
-  void run_a_cycle();
-  bool access(mem_req_s* req);
+  virtual ~simple_mem_c();
+
+  virtual void run_a_cycle();
+  virtual bool access(mem_req_s* req);
+  virtual void print_stats();
   void configure_neighbors(cache_c* prev);
+  void configure_neighbors(cache_c* prev_i, cache_c* prev_d);  ///< split L1 right above main memory
   const std::string& get_name() { return m_name; }
 
   void process_in_queue();
   void process_out_queue();
 
   queue_c* m_in_flight_wb_queue;     // in-flight wb queue
-                                     
+
   // callback for done requests
 public:
   using callback_t = std::function<void(mem_req_s*)>;
 
-  callback_t done_func;              // callback 
+  callback_t done_func;              // callback
   void set_done_func(callback_t cb) { done_func = std::move(cb); }
 
-private:
+protected:
+  void schedule_done(mem_req_s* req, counter done_cycle);  ///< complete req at done_cycle
+
+  /// pending request in the in-queue, keyed on its completion cycle
+  struct pending_req_s {
+    counter    m_rdy_cycle;          // cycle when the access completes
+    counter    m_seq;                // arrival order (breaks ties in FIFO order)
+    mem_req_s* m_req;
+
+    bool operator>(const pending_req_s& rhs) const {
+      if (m_rdy_cycle != rhs.m_rdy_cycle) return m_rdy_cycle > rhs.m_rdy_cycle;
+      return m_seq > rhs.m_seq;
+    }
+  };
+
   std::string m_name;                // memory name
   uint32_t m_latency;                // memory latency
   int m_level;                       // memory level
                                      //
-  queue_c* m_in_queue;               // input queue 
-  queue_c* m_out_queue;              // out queue 
+  std::priority_queue<pending_req_s, std::vector<pending_req_s>,
+                      std::greater<pending_req_s> > m_in_queue;  // min-heap on completion cycle
+  counter m_seq;                     // next arrival sequence number
+  queue_c* m_out_queue;              // out queue
   counter m_cycle;                   // memory cycle
-  cache_c* m_prev;                   // previous level cache pointer                                   
+  cache_c* m_prev;                   // previous level cache pointer
+  cache_c* m_prev_i;                 // previous level cache for REQ_IFETCH (m_prev if not split)
+
+  counter m_num_reads;               // # read requests
+  counter m_num_writes;              // # write-back requests
 
 };
 
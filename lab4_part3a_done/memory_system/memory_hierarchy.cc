@@ -13,83 +13,200 @@
 
 #include "memory_hierarchy.h"
 #include "cache.h"
+#include "memory_controller/dram_ctrl.h"
 
+#include <algorithm>
 #include <cassert>
 #include <stdio.h>
 #include <cstring>
+#include <unordered_set>
 
 using namespace std;
 
-memory_hierarchy_c::memory_hierarchy_c(config_c& config) {
+memory_hierarchy_c::memory_hierarchy_c(config_c& config, int num_cores) {
 
   m_config = config;
-  m_mem_req_id = 0;    // starting unique request id
+  m_num_cores = num_cores;
+  m_core_in_flight.assign(num_cores, 0);
+  m_core_req_id.assign(num_cores, 0);
+  m_core_done_funcs.resize(num_cores);
+  m_core_batch_done_funcs.resize(num_cores);
+  m_free_reqs.resize(num_cores);
+  m_batch_reqs.resize(num_cores);
+  m_num_ifetch_misses.assign(num_cores, 0);
+  m_ifetch_stall_cycles.assign(num_cores, 0);
+  m_num_data_misses.assign(num_cores, 0);
+  m_data_stall_cycles.assign(num_cores, 0);
   m_cycle = 0;         // memory hierarchy cycle
 
-  m_l1u_cache = nullptr;
-  m_l1i_cache = nullptr;                     
-  m_l1d_cache = nullptr;                     
-  m_l2_cache = nullptr;                     
+  m_num_private_levels = 0;
   m_dram = nullptr;
+  m_dram_wait_queue = new queue_c();
 
-  caches[0] = &m_l1u_cache;
-  caches[1] = &m_l1i_cache;
-  caches[2] = &m_l1d_cache;
-  caches[3] = &m_l2_cache;                 
-
-  m_done_queue = new queue_c();
+  for (int core = 0; core < num_cores; ++core) {
+    m_done_queues.push_back(new queue_c());
+  }
 
   init(config);
 
   // set done requests callback function for children.
-  if (config.get_mem_hierarchy() == static_cast<int>(Hierarchy::DRAM_ONLY)) {
-    assert(m_dram && "main memory is not instantiated");
-    m_dram->set_done_func(std::bind(&memory_hierarchy_c::push_done_req, this, std::placeholders::_1));
-  } 
-  
-  else if (config.get_mem_hierarchy() == static_cast<int>(Hierarchy::SINGLE_LEVEL)) {
-    assert(m_dram && "main memory is not instantiated");
-    m_dram->set_done_func(std::bind(&memory_hierarchy_c::push_done_req, this, std::placeholders::_1));
-    m_l1u_cache->set_done_func(std::bind(&memory_hierarchy_c::push_done_req, this, std::placeholders::_1));
+  assert(m_dram && "main memory is not instantiated");
+  m_dram->set_done_func(std::bind(&memory_hierarchy_c::push_done_req, this, std::placeholders::_1));
+  for (auto& level : m_levels) {
+    for (auto cache : level) {
+      cache->set_done_func(std::bind(&memory_hierarchy_c::push_done_req, this, std::placeholders::_1));
+    }
+  }
+  for (auto cache : m_l1i_caches) {
+    cache->set_done_func(std::bind(&memory_hierarchy_c::push_done_req, this, std::placeholders::_1));
   }
-   
-  else if (config.get_mem_hierarchy() == static_cast<int>(Hierarchy::MULTI_LEVEL)) {
-    //L1 UNIFIED
-    assert(m_dram && "main memory is not instantiated");
-    m_dram->set_done_func(std::bind(&memory_hierarchy_c::push_done_req, this, std::placeholders::_1));
-    m_l1u_cache->set_done_func(std::bind(&memory_hierarchy_c::push_done_req, this, std::placeholders::_1));
-    m_l2_cache->set_done_func(std::bind(&memory_hierarchy_c::push_done_req, this, std::placeholders::_1));
+}
+
+/**
+ * This checks the cache levels of a configuration before init() builds them
+ * (init() asserts the same).
+ */
+std::string memory_hierarchy_c::check(const config_c& config, int num_cores) {
+  const std::vector<cache_level_s>& levels = config.get_cache_levels();
+  int num_levels = levels.size();
+  int num_private = 0;
+  while (num_private < num_levels && !levels[num_private].m_shared) num_private++;
+
+  for (int ii = num_private; ii < num_levels; ++ii) {
+    if (!levels[ii].m_shared) return "a private cache level cannot be below a shared one";
   }
+  if (num_cores > 1 && (num_levels == 0 || levels[0].m_shared || !levels.back().m_shared))
+    return "multi-core simulation needs private L1s and a shared last-level cache";
+  if (config.get_l1_split() && num_levels > 0 && levels[0].m_shared && num_cores > 1)
+    return "a split L1 must be private";
+  if (config.is_l1_filtered() && num_levels > 0 && levels[0].m_inclusion == INCL_EXCLUSIVE)
+    return "an exclusive level cannot take an L1-filtered trace (it moves lines up)";
+  if (num_cores > 1 && config.get_coherence() && (num_private != 1 || levels[1].m_inclusion != INCL_INCLUSIVE))
+    return "MESI coherence needs private L1s right above an inclusive shared level (set coherence = 0)";
+  return "";
 }
 
 /**
  * This initializes the memory hierarchy to simulate with a given configuration.
+ * The caches are built level by level from config_c::get_cache_levels(): a
+ * private level gets one cache per core, and a shared level one cache that
+ * arbitrates among the caches above it. Each cache is connected to the
+ * cache(s) above it and to the one below it, and the last level to main
+ * memory. With l1_split, each core also gets an L1I (l1i_* settings) next to
+ * the top level, which then serves data only; the level below sees them as
+ * its I and D previous levels.
  */
 void memory_hierarchy_c::init(config_c& config) {
-  ////////////////////////////////////////////////////////////////////
-  // TODO: Write the code to implement this function
-  // 1. Instantiate caches and main memory (e.g., DRAM)
-  // 2. Configure neighbors of each cache
-  ////////////////////////////////////////////////////////////////////
-  
-  // instantiate caches and main memory (e.g., DRAM)
-  m_dram = new simple_mem_c("DRAM", MEM_MC, config.get_memory_latency());
+  const std::vector<cache_level_s>& levels = config.get_cache_levels();
+  int num_levels = levels.size();
+
+  // instantiate main memory (e.g., DRAM)
+  if (config.get_memory_model() == static_cast<int>(MemoryModel::DRAM)) {
+    int line_size = levels.empty() ? config.get_l1d_line_size() : levels.back().m_line_size;
+    m_dram = new dram_ctrl_c("DRAM", MEM_MC, config, line_size);
+  } else {
+    m_dram = new simple_mem_c("DRAM", MEM_MC, config.get_memory_latency());
+  }
 
-  if (config.get_mem_hierarchy() == static_cast<int>(Hierarchy::DRAM_ONLY)) {
-    m_dram->configure_neighbors(nullptr);
-  } else if (config.get_mem_hierarchy() == static_cast<int>(Hierarchy::SINGLE_LEVEL)) {
-    //L1U is made with L1D specs.
-    m_dram->configure_neighbors(m_l1u_cache);
-    m_l1u_cache = new cache_c("L1", cache_c::L1, config.get_l1d_size()/config.get_l1d_line_size()/config.get_l1d_assoc(), config.get_l1d_assoc(), config.get_l1d_line_size(), config.get_l1d_latency());
-    m_l1u_cache->configure_neighbors(nullptr, nullptr, nullptr, m_dram);
-  } else if (config.get_mem_hierarchy() == static_cast<int>(Hierarchy::MULTI_LEVEL)) {
-    //L1 IS UNIFIED
-    m_dram->configure_neighbors(m_l2_cache);
-    m_l2_cache = new cache_c("L2", cache_c::L2, config.get_l2_size()/config.get_l2_line_size()/config.get_l2_assoc(), config.get_l2_assoc(), config.get_l2_line_size(), config.get_l2_latency());
-    m_l1u_cache = new cache_c("L1", cache_c::L1, config.get_l1d_size()/config.get_l1d_line_size()/config.get_l1d_assoc(), config.get_l1d_assoc(), config.get_l1d_line_size(), config.get_l1d_latency());
+  // the private levels come first; main memory returns data to a single cache
+  for (auto& level : levels) {
+    if (!level.m_shared && m_num_private_levels == (int)m_level_shared.size()) m_num_private_levels++;
+    m_level_shared.push_back(level.m_shared && m_num_cores > 1);
+  }
+  for (int ii = m_num_private_levels; ii < num_levels; ++ii) {
+    assert(levels[ii].m_shared && "a private cache level cannot be below a shared one");
+  }
+  assert((m_num_cores == 1 || (num_levels > 0 && !levels[0].m_shared && levels.back().m_shared)) &&
+         "multi-core simulation needs private L1s and a shared last-level cache");
+
+  bool split = config.get_l1_split() && num_levels > 0;
+  assert((!split || !levels[0].m_shared || m_num_cores == 1) && "a split L1 must be private");
+
+  // below an L1-filtered trace, the top level keeps its number and its inclusion policy
+  int first_level = config.is_l1_filtered() ? 2 : 1;
+  assert((!config.is_l1_filtered() || num_levels == 0 || levels[0].m_inclusion != INCL_EXCLUSIVE) &&
+         "an exclusive level cannot take an L1-filtered trace (it moves lines up)");
+
+  // instantiate caches
+  for (int ii = 0; ii < num_levels; ++ii) {
+    const cache_level_s& level = levels[ii];
+    int num_caches = m_level_shared[ii] ? 1 : m_num_cores;
+    std::string level_name = (split && ii == 0) ? level.m_name + "D" : level.m_name;
+    m_levels.push_back(std::vector<cache_c*>());
+
+    for (int core = 0; core < num_caches; ++core) {
+      std::string name = (num_caches == 1) ? level_name : "Core " + std::to_string(core) + " " + level_name;
+      cache_c* cache = new cache_c(name, first_level + ii, level.m_size/level.m_line_size/level.m_assoc, level.m_assoc, level.m_line_size, level.m_latency);
+      cache->set_core_id(core);
+      cache->set_prefetcher(prefetcher_c::create(level.m_prefetcher, level.m_line_size, level.m_prefetch_degree));
+      if (ii > 0 || first_level > 1) cache->set_inclusion(level.m_inclusion);
+      if (ii == 0 && first_level > 1) cache->set_l1_filtered();
+      if (m_level_shared[ii]) cache->set_input_ports(config.get_l2_ports());
+      m_levels[ii].push_back(cache);
+    }
+  }
 
-    m_l2_cache->configure_neighbors(m_l1u_cache, m_l1u_cache, nullptr, m_dram);
-    m_l1u_cache->configure_neighbors(nullptr, nullptr, m_l2_cache, m_dram);
+  for (int core = 0; split && core < m_num_cores; ++core) {
+    std::string name = levels[0].m_name + "I";
+    if (m_num_cores > 1) name = "Core " + std::to_string(core) + " " + name;
+    cache_c* cache = new cache_c(name, 1, config.get_l1i_size()/config.get_l1i_line_size()/config.get_l1i_assoc(),
+                                 config.get_l1i_assoc(), config.get_l1i_line_size(), config.get_l1i_latency());
+    cache->set_core_id(core);
+    cache->set_prefetcher(prefetcher_c::create(levels[0].m_prefetcher, config.get_l1i_line_size(), levels[0].m_prefetch_degree));
+    m_l1i_caches.push_back(cache);
+  }
+
+  // configure neighbors of each cache
+  for (int ii = 0; ii < num_levels; ++ii) {
+    for (int jj = 0; jj < (int)m_levels[ii].size(); ++jj) {
+      cache_c* cache = m_levels[ii][jj];
+      cache_c* next = (ii + 1 < num_levels) ? get_cache(ii + 1, jj) : nullptr;
+
+      if (ii == 0) {
+        cache->configure_neighbors(nullptr, nullptr, next, m_dram);
+        if (split) m_l1i_caches[jj]->configure_neighbors(nullptr, nullptr, next, m_dram);
+      } else if (m_level_shared[ii] && !m_level_shared[ii - 1]) {
+        // one cache above per core
+        const std::vector<cache_c*>& prev_i = (split && ii == 1) ? m_l1i_caches : m_levels[ii - 1];
+        cache->configure_neighbors(prev_i, m_levels[ii - 1], next, m_dram);
+      } else {
+        cache_c* prev = m_levels[ii - 1][jj];
+        cache->configure_neighbors((split && ii == 1) ? m_l1i_caches[jj] : prev, prev, next, m_dram);
+      }
+    }
+  }
+  if (num_levels == 1 && split) {
+    m_dram->configure_neighbors(m_l1i_caches[0], m_levels[0][0]);
+  } else {
+    m_dram->configure_neighbors(levels.empty() ? nullptr : m_levels.back()[0]);
+  }
+
+  // MESI among the private L1s; the sharer directory lives in the shared level right below
+  if (m_num_cores > 1 && config.get_coherence()) {
+    assert(m_num_private_levels == 1 && levels[1].m_inclusion == INCL_INCLUSIVE &&
+           "MESI coherence needs private L1s right above an inclusive shared level");
+    for (auto l1 : m_levels[0]) l1->set_coherence();
+    for (auto l1 : m_l1i_caches) l1->set_coherence();
+    m_levels[1][0]->set_coherence();
+  }
+
+  // victim cache behind every L1
+  std::vector<cache_c*> l1s = m_l1i_caches;
+  if (num_levels > 0) l1s.insert(l1s.end(), m_levels[0].begin(), m_levels[0].end());
+  for (int ii = 0; config.get_victim_cache_size() > 0 && ii < (int)l1s.size(); ++ii) {
+    int line_size = (ii < (int)m_l1i_caches.size()) ? config.get_l1i_line_size() : levels[0].m_line_size;
+    l1s[ii]->set_victim_cache(new victim_cache_c(l1s[ii]->get_name() + " victim cache", config.get_victim_cache_size()/line_size,
+                                                 line_size, config.get_victim_cache_latency()));
+  }
+
+  // instruction-stream prefetcher on the L1 that serves REQ_IFETCH
+  if (config.get_ifetch_prefetcher()) {
+    for (auto l1i : m_l1i_caches) {
+      l1i->set_inst_prefetcher(prefetcher_c::create(PREF_IFETCH, config.get_l1i_line_size(), config.get_ifetch_prefetch_depth()));
+    }
+    for (int ii = 0; !split && !m_levels.empty() && ii < (int)m_levels[0].size(); ++ii) {
+      m_levels[0][ii]->set_inst_prefetcher(prefetcher_c::create(PREF_IFETCH, levels[0].m_line_size, config.get_ifetch_prefetch_depth()));
+    }
   }
 }
 
@@ -98,38 +215,202 @@ void memory_hierarchy_c::init(config_c& config) {
  * memory components in the memory hierarchy (e.g., L1 or main memory). 
  */
 
-bool memory_hierarchy_c::access(addr_t address, int access_type) {
+bool memory_hierarchy_c::access(addr_t address, int access_type, int core_id, uint32_t* req_id, uint32_t size) {
 
   // create a memory request
-  mem_req_s* req = create_mem_req(address, access_type);
+  mem_req_s* req = create_mem_req(address, access_type, core_id, size);
+  if (req_id) *req_id = req->m_id;
 
-  m_in_flight_reqs.push_back(req);
+  m_core_in_flight[core_id]++;
 
   ////////////////////////////////////////////////////////////////////
   // TODO: Write the code to implement this function
   // Access the top-level memory component
   ////////////////////////////////////////////////////////////////////
-  if (m_config.get_mem_hierarchy() == static_cast<int>(Hierarchy::DRAM_ONLY)) {
-    m_dram->access(req);
-  } else if (m_config.get_mem_hierarchy() == static_cast<int>(Hierarchy::SINGLE_LEVEL)) {
-    m_l1u_cache->access(req);
-  } else if (m_config.get_mem_hierarchy() == static_cast<int>(Hierarchy::MULTI_LEVEL)) {
-    m_l1u_cache->access(req);
+  send_to_top(req);
+
+  return true;
+}
+
+/**
+ * This sends a batch of accesses of a core in the same cycle, in order, the
+ * same as calling access() for each of them. The requests come from the
+ * core's free list, so a batch normally allocates nothing, and they enter
+ * the input queue of the top-level cache together (cache_c::access_batch()).
+ * If the cache takes only part of the batch, the rest is dropped: those
+ * requests go back to the free list and their ids are reused, so the caller
+ * can send them again later.
+ * @param req_ids - if not null, receives the id of each request
+ * @return the number of accesses sent (the first ones of the batch)
+ */
+int memory_hierarchy_c::access_batch(const mem_access_s* accesses, int num, int core_id, uint32_t* req_ids) {
+  if (num <= 0) return 0;
+
+  std::vector<mem_req_s*>& reqs = m_batch_reqs[core_id];
+  reqs.clear();
+  m_core_in_flight[core_id] += num;
+  for (int ii = 0; ii < num; ++ii) {
+    mem_req_s* req = create_mem_req(accesses[ii].m_addr, accesses[ii].m_type, core_id, accesses[ii].m_size);
+    if (req_ids) req_ids[ii] = req->m_id;
+    reqs.push_back(req);
+  }
+
+  // one insertion per run of requests that go to the same port (I or D with a split L1)
+  int sent = 0;
+  for (int start = 0, end; start < num; start = end) {
+    cache_c* cache = get_top_cache(reqs[start]->m_type, core_id);
+    for (end = start + 1; end < num && get_top_cache(reqs[end]->m_type, core_id) == cache; ++end) {}
+    if (cache) {
+      sent += cache->access_batch(&reqs[start], end - start);
+      if (sent < end) break;
+    } else {
+      for (int ii = start; ii < end; ++ii) send_to_dram(reqs[ii]);
+      sent = end;
+    }
+  }
+
+  // the requests that did not fit were never sent
+  for (int ii = num - 1; ii >= sent; --ii) free_mem_req(reqs[ii]);
+  m_core_req_id[core_id] -= num - sent;
+  return sent;
+}
+
+void memory_hierarchy_c::send_to_top(mem_req_s* req) {
+  cache_c* cache = get_top_cache(req->m_type, req->m_core_id);
+  if (cache) {
+    cache->access(req);
+  } else {
+    send_to_dram(req);
+  }
+}
+
+/**
+ * Main memory refuses a request when its queue is full. The request then
+ * waits here, and the waiting requests are sent first, in order, at the
+ * start of the next cycles.
+ */
+void memory_hierarchy_c::send_to_dram(mem_req_s* req) {
+  if (!m_dram_wait_queue->empty() || !m_dram->access(req)) m_dram_wait_queue->push(req);
+}
+
+void memory_hierarchy_c::retry_dram() {
+  while (!m_dram_wait_queue->empty()) {
+    mem_req_s* req = m_dram_wait_queue->m_entry[0];
+    if (!m_dram->access(req)) break;
+    m_dram_wait_queue->pop(req);
   }
-  
+}
+
+cache_c* memory_hierarchy_c::get_top_cache(int access_type, int core_id) {
+  if (m_levels.empty()) return nullptr;
+  if (is_l1_split() && access_type == REQ_IFETCH) return m_l1i_caches[core_id];
+  return get_cache(0, core_id);
 }
 
 /**
- * Create a new memory request that goes through memory hierarchy.  
- * @note You do not have to modify this (other than for debugging purposes).
+ * [L1 Filter]
+ *
+ * An L1-filtered trace (l1_filter_c) holds what the L1s sent below them:
+ * their misses and prefetches, and their write-backs to the next level or
+ * straight to memory. Replayed on a hierarchy built by config_c::filter_l1(),
+ * each goes where the L1 sent it: a miss or prefetch into the top level (the
+ * former L2), a write-back into its fill queue or into main memory.
+ * @param pf_level - the level of the L1 prefetch (0: demand request)
  */
-mem_req_s* memory_hierarchy_c::create_mem_req(addr_t address, int access_type) { 
+void memory_hierarchy_c::access_below_l1(addr_t address, int access_type, uint32_t size, int pf_level, bool dirty, bool to_memory) {
+  cache_c* cache = get_top_cache(access_type, 0);
+  if (access_type == REQ_WB) {
+    mem_req_s* wb = new mem_req_s(address, REQ_WB);
+    wb->m_id = 0;
+    wb->m_in_cycle = m_cycle;
+    wb->m_rdy_cycle = m_cycle;
+    wb->m_done = false;
+    wb->m_dirty = dirty;
+    if (cache && !to_memory) {
+      cache->fill(wb);
+    } else {
+      send_to_dram(wb);
+    }
+    return;
+  }
+
+  mem_req_s* req = create_mem_req(address, access_type, 0, size);
+  req->m_pf_level = pf_level;
+  m_core_in_flight[0]++;
+  send_to_top(req);
+}
+
+void memory_hierarchy_c::set_l1_out_func(std::function<void(mem_req_s*, bool)> cb) {
+  for (auto cache : m_l1i_caches) cache->set_out_func(cb);
+  if (!m_levels.empty()) {
+    for (auto cache : m_levels[0]) cache->set_out_func(cb);
+  }
+}
+
+/**
+ * [Fast-Forward]
+ *
+ * Between begin_fast_forward() and end_fast_forward(), warm() runs an access
+ * through the tag stores of the hierarchy functionally (see
+ * cache_c::warm_access()): the caches end up with the lines, LRU order,
+ * inclusion and MESI state of a timed run, without queues or cycles. The
+ * timed simulation then starts from the warmed caches, with all the
+ * statistics cleared.
+ */
+void memory_hierarchy_c::begin_fast_forward() {
+  for (auto cache : get_caches()) cache->set_warming(true);
+}
+
+int memory_hierarchy_c::warm(addr_t address, int access_type, int core_id) {
+  cache_c* cache = get_top_cache(access_type, core_id);
+  if (!cache) return 1;
+
+  mem_req_s req(address, access_type);
+  req.m_id = 0;
+  req.m_core_id = core_id;
+  req.m_in_cycle = 0;
+  req.m_rdy_cycle = 0;
+  req.m_done = false;
+  req.m_dirty = false;
+  return cache->warm_access(&req);
+}
+
+void memory_hierarchy_c::end_fast_forward(bool reset_stats) {
+  for (auto cache : get_caches()) {
+    cache->set_warming(false);
+    if (reset_stats) cache->reset_stats();
+  }
+}
+
+std::vector<cache_c*> memory_hierarchy_c::get_caches() {
+  std::vector<cache_c*> caches = m_l1i_caches;
+  for (auto& level : m_levels) caches.insert(caches.end(), level.begin(), level.end());
+  return caches;
+}
+
+/**
+ * Create a new memory request that goes through memory hierarchy. A request
+ * the core freed earlier (free_mem_req()) is reused when there is one.
+ */
+mem_req_s* memory_hierarchy_c::create_mem_req(addr_t address, int access_type, int core_id, uint32_t size) { 
   
-  mem_req_s* req = new mem_req_s(address, access_type);
+  // reuse a request of this core freed earlier (both run on the core's thread)
+  mem_req_s* req;
+  std::vector<mem_req_s*>& free_reqs = m_free_reqs[core_id];
+  if (free_reqs.empty()) {
+    req = new mem_req_s(address, access_type);
+  } else {
+    req = free_reqs.back();
+    free_reqs.pop_back();
+    *req = mem_req_s(address, access_type);
+  }
 
-  req->m_id = m_mem_req_id++;
-  req->m_in_cycle = m_cycle;
-  req->m_rdy_cycle = m_cycle;
+  // the id and the cycle are per core so that cores can run on separate threads
+  req->m_id = m_core_req_id[core_id]++;
+  req->m_core_id = core_id;
+  req->m_size = size;
+  req->m_in_cycle = get_core_cycle(core_id);
+  req->m_rdy_cycle = req->m_in_cycle;
   req->m_done = false;
   req->m_dirty = false;
 
@@ -142,9 +423,8 @@ mem_req_s* memory_hierarchy_c::create_mem_req(addr_t address, int access_type) {
  */
 void memory_hierarchy_c::free_mem_req(mem_req_s* req) {
 
-  auto& vv = m_in_flight_reqs;
-  vv.erase(std::remove(vv.begin(), vv.end(), req), vv.end());
-  delete req;
+  m_core_in_flight[req->m_core_id]--;
+  m_free_reqs[req->m_core_id].push_back(req);
 
 #ifdef __DEBUG__
   //dump(false); // print out cache dump
@@ -161,23 +441,153 @@ void memory_hierarchy_c::run_a_cycle() {
   // Think carefully what should be the order of run_a_cycle
   // 2. Process done requests.
   ////////////////////////////////////////////////////////////////////
-  if (m_config.get_mem_hierarchy() == static_cast<int>(Hierarchy::DRAM_ONLY)) {
-      m_dram->run_a_cycle();
-  } else if (m_config.get_mem_hierarchy() == static_cast<int>(Hierarchy::SINGLE_LEVEL)) {
-      m_l1u_cache->run_a_cycle();
-      m_dram->run_a_cycle();
-  } else if (m_config.get_mem_hierarchy() == static_cast<int>(Hierarchy::MULTI_LEVEL)) {
-    //L1 unified
-    m_l1u_cache->run_a_cycle();
-    m_l2_cache->run_a_cycle();
-    m_dram->run_a_cycle();
+  retry_dram();
+
+  // from the top level down, then main memory (a core's L1I before its L1D)
+  for (int ii = 0; ii < (int)m_levels.size(); ++ii) {
+    for (int jj = 0; jj < (int)m_levels[ii].size(); ++jj) {
+      if (ii == 0 && is_l1_split()) m_l1i_caches[jj]->run_a_cycle();
+      m_levels[ii][jj]->run_a_cycle();
+    }
   }
+  m_dram->run_a_cycle();
 
   process_done_req();
 
   ++m_cycle; 
 }
 
+/**
+ * The L1 (and the core) of a core see the current cycle through its L1 so
+ * that a core running on its own thread never reads shared state.
+ */
+counter memory_hierarchy_c::get_core_cycle(int core_id) {
+  return m_levels.empty() ? m_cycle : get_cache(0, core_id)->get_cycle();
+}
+
+/**
+ * The private caches of a core at a level: both L1s at level 0 if the L1 is
+ * split, in the order they run in a cycle.
+ */
+std::vector<cache_c*> memory_hierarchy_c::get_private_caches(int level, int core_id) {
+  if (level == 0 && is_l1_split()) return {m_l1i_caches[core_id], get_cache(0, core_id)};
+  return {get_cache(level, core_id)};
+}
+
+/**
+ * This switches the multi-core hierarchy to parallel simulation. The traffic
+ * between each core's last private level and the first shared level then
+ * goes through a pair of SPSC links instead of direct calls: each core
+ * thread runs its private caches with run_core_cycle(), and one thread runs
+ * the shared levels and main memory with run_shared_cycle().
+ */
+void memory_hierarchy_c::enable_parallel() {
+  assert(m_num_cores > 1 && m_num_private_levels > 0 && m_num_private_levels < (int)m_levels.size());
+
+  for (int core = 0; core < m_num_cores; ++core) {
+    m_down_links.push_back(new link_c());
+    m_up_links.push_back(new link_c());
+    for (auto cache : get_private_caches(m_num_private_levels - 1, core)) {
+      cache->set_down_link(m_down_links[core]);
+    }
+  }
+  get_cache(m_num_private_levels, 0)->set_up_links(m_up_links);
+}
+
+/**
+ * The smallest number of cycles between a message from the shared levels and
+ * its effect on the last private level; a core can run that far ahead
+ * without new messages.
+ */
+int memory_hierarchy_c::get_lookahead() {
+  int lookahead = m_config.get_cache_levels()[m_num_private_levels - 1].m_latency;
+  if (m_num_private_levels == 1 && is_l1_split()) lookahead = std::min(lookahead, m_config.get_l1i_latency());
+  return lookahead;
+}
+
+/**
+ * The private part of a cycle for one core (parallel simulation): messages
+ * that arrived since the last call go into the queues of the last private
+ * level first. A message for one cache carries its presence bit; MESI
+ * invalidations and downgrades (m_cache < 0) go to all the caches of the
+ * core.
+ */
+void memory_hierarchy_c::run_core_cycle(int core_id) {
+  std::vector<cache_c*> boundary = get_private_caches(m_num_private_levels - 1, core_id);
+  link_c* link = m_up_links[core_id];
+  for (link_msg_s* msg = link->front(); msg; msg = link->front()) {
+    for (auto cache : boundary) {
+      if (boundary.size() == 1 || msg->m_cache < 0 || msg->m_cache == cache->get_presence_bit()) cache->receive(*msg);
+    }
+    link->pop();
+  }
+
+  for (int ii = 0; ii < m_num_private_levels; ++ii) {
+    for (auto cache : get_private_caches(ii, core_id)) cache->run_a_cycle();
+  }
+  process_done_req(core_id);
+}
+
+/**
+ * The shared part of a cycle (parallel simulation). The messages the cores
+ * sent in this cycle are applied in core order, which is the order the
+ * private caches run in serial simulation, and then the shared levels and
+ * main memory tick.
+ */
+void memory_hierarchy_c::run_shared_cycle() {
+  cache_c* shared = m_levels[m_num_private_levels][0];
+  retry_dram();
+  for (auto link : m_down_links) {
+    for (link_msg_s* msg = link->front(); msg && msg->m_cycle == m_cycle; msg = link->front()) {
+      if (msg->m_type == LINK_ACCESS) {
+        shared->access(msg->m_req);
+      } else if (msg->m_type == LINK_FILL) {
+        shared->fill(msg->m_req);
+      } else if (msg->m_type == LINK_EVICT) {
+        shared->evict_notify(msg->m_addr, msg->m_cache);
+      } else {
+        send_to_dram(msg->m_req);
+      }
+      link->pop();
+    }
+  }
+
+  for (int ii = m_num_private_levels; ii < (int)m_levels.size(); ++ii) {
+    m_levels[ii][0]->run_a_cycle();
+  }
+  m_dram->run_a_cycle();
+  ++m_cycle;
+}
+
+/**
+ * # messages the shared levels have sent to a core (parallel simulation).
+ */
+size_t memory_hierarchy_c::get_num_sent_to_core(int core_id) {
+  return m_up_links[core_id]->get_num_pushed();
+}
+
+/**
+ * True if the private caches of a core have nothing queued or in flight.
+ */
+bool memory_hierarchy_c::is_core_idle(int core_id) {
+  for (int ii = 0; ii < m_num_private_levels; ++ii) {
+    for (auto cache : get_private_caches(ii, core_id)) {
+      if (!cache->is_idle()) return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * is_wb_done() for the shared levels only (the private caches are covered by is_core_idle()).
+ */
+bool memory_hierarchy_c::is_shared_wb_done() {
+  for (int ii = m_num_private_levels; ii < (int)m_levels.size(); ++ii) {
+    if (!m_levels[ii][0]->m_in_flight_wb_queue->empty()) return false;
+  }
+  return m_dram_wait_queue->empty() && m_dram->m_in_flight_wb_queue->empty();
+}
+
 /**
  * This function processes the done request. The done_queue contains the
  * requests whose data is ready to return to the core.  Processing a "done
@@ -188,11 +598,27 @@ void memory_hierarchy_c::process_done_req() {
   // TODO: Write the code to implement this function
   // Free done requests
   ////////////////////////////////////////////////////////////////////
-  while (!m_done_queue->empty()) {
-    mem_req_s * req_to_delete = m_done_queue->m_entry[0];
-    m_done_queue->pop(req_to_delete);
-    m_in_flight_reqs.erase(std::remove(m_in_flight_reqs.begin(), m_in_flight_reqs.end(), req_to_delete), m_in_flight_reqs.end());
+  for (int core = 0; core < m_num_cores; ++core) {
+    process_done_req(core);
+  }
+}
+
+/**
+ * The done requests of a core are handed to its callbacks (the batch one
+ * gets all of them at once, in the order they returned) and freed together.
+ */
+void memory_hierarchy_c::process_done_req(int core_id) {
+  std::vector<mem_req_s*>& done_reqs = m_done_queues[core_id]->m_entry;
+  if (done_reqs.empty()) return;
+
+  if (m_core_batch_done_funcs[core_id]) {
+    m_core_batch_done_funcs[core_id](done_reqs.data(), done_reqs.size());
+  }
+  for (auto req : done_reqs) {
+    if (m_core_done_funcs[core_id]) m_core_done_funcs[core_id](req);
+    free_mem_req(req);
   }
+  done_reqs.clear();
 }
 
 /**
@@ -200,8 +626,37 @@ void memory_hierarchy_c::process_done_req() {
  * This is called Tfrom the top-level memory component.
  */
 void memory_hierarchy_c::push_done_req(mem_req_s* req) {
-  DEBUG("[MEM_H] Done REQ #%d %8lx @ %ld\n", req->m_id, req->m_addr, m_cycle);
-  m_done_queue->push(req);
+  int core = req->m_core_id;
+  counter cycle = get_core_cycle(core);
+  DEBUG("[MEM_H] Done REQ #%d %8lx @ %ld\n", req->m_id, req->m_addr, cycle);
+
+  // anything slower than an L1 hit stalled the fetch (or the data access)
+  if (!m_levels.empty()) {
+    bool is_ifetch = (req->m_type == REQ_IFETCH);
+    int l1_latency = get_hit_latency(req->m_type);
+    counter latency = cycle - req->m_in_cycle;
+    if (latency > (counter)l1_latency && is_ifetch) {
+      m_num_ifetch_misses[core]++;
+      m_ifetch_stall_cycles[core] += latency - l1_latency;
+    } else if (latency > (counter)l1_latency) {
+      m_num_data_misses[core]++;
+      m_data_stall_cycles[core] += latency - l1_latency;
+    }
+  }
+
+  m_done_queues[core]->push(req);
+}
+
+int memory_hierarchy_c::get_hit_latency(int access_type) {
+  if (m_levels.empty()) return 0;
+  if (access_type == REQ_IFETCH && is_l1_split()) return m_config.get_l1i_latency();
+  return m_config.get_cache_levels()[0].m_latency;
+}
+
+int memory_hierarchy_c::get_line_size(int access_type) {
+  if (m_levels.empty()) return m_config.get_l1d_line_size();
+  if (access_type == REQ_IFETCH && is_l1_split()) return m_config.get_l1i_line_size();
+  return m_config.get_cache_levels()[0].m_line_size;
 }
 
 /**
@@ -214,51 +669,76 @@ bool memory_hierarchy_c::is_wb_done() {
   // If there is no in-flight writeback requests for all the caches and
   // main memory, return true.
   ////////////////////////////////////////////////////////////////////
-  /*
-    for (int i = 0; i < cache_types; i++) {
-      if (*(caches[i]) != nullptr) {
-        if (!(*(caches[i]))->m_in_flight_wb_queue->empty()) return false;
-      }
+  for (auto& level : m_levels) {
+    for (auto cache : level) {
+      if (!cache->m_in_flight_wb_queue->empty()) return false;
     }
-    if (!m_dram->m_in_flight_wb_queue->empty())
-    {
-      return false;
-    }
-  return true; */ 
-  bool res;
-  if (m_config.get_mem_hierarchy() == static_cast<int>(Hierarchy::DRAM_ONLY)) {
-    res = m_dram->m_in_flight_wb_queue->empty();
-  } else if (m_config.get_mem_hierarchy() == static_cast<int>(Hierarchy::SINGLE_LEVEL)) {
-    res = m_dram->m_in_flight_wb_queue->empty() && m_l1u_cache->m_in_flight_wb_queue->empty();
-  } else if (m_config.get_mem_hierarchy() == static_cast<int>(Hierarchy::MULTI_LEVEL)) {
-    res = m_dram->m_in_flight_wb_queue->empty() && m_l1u_cache->m_in_flight_wb_queue->empty() && m_l2_cache->m_in_flight_wb_queue->empty(); 
   }
-
-  
-  return res;
+  for (auto cache : m_l1i_caches) {
+    if (!cache->m_in_flight_wb_queue->empty()) return false;
+  }
+  return m_dram_wait_queue->empty() && m_dram->m_in_flight_wb_queue->empty();
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////
 memory_hierarchy_c::~memory_hierarchy_c() {
-  if (m_l1i_cache) delete m_l1i_cache;
-  if (m_l1d_cache) delete m_l1d_cache;
-  if (m_l2_cache)  delete m_l2_cache;
+  for (auto& level : m_levels) {
+    for (auto cache : level) delete cache;
+  }
+  for (auto cache : m_l1i_caches) delete cache;
+  for (auto queue : m_done_queues) delete queue;
+  for (auto& free_reqs : m_free_reqs) {
+    for (auto req : free_reqs) delete req;
+  }
+  for (auto link : m_down_links) delete link;
+  for (auto link : m_up_links) delete link;
   if (m_dram)      delete m_dram;
+  delete m_dram_wait_queue;
 }
 
 void memory_hierarchy_c::print_stats() {
+  for (auto cache : get_caches()) cache->print_stats();
+
+  if (m_levels.size() > 1 || is_l1_split()) {
+    // distinct lines held in all the caches at the end of the simulation
+    std::unordered_set<addr_t> lines;
+    int num_lines = 0;
+    int num_inclusion_victims = 0;
+    for (auto cache : get_caches()) {
+      cache->get_lines(lines);
+      num_lines += cache->get_num_lines();
+      num_inclusion_victims += cache->get_num_backinvals();
+    }
+    std::cout << "effective capacity: " << lines.size() << " lines ("
+              << (double)lines.size()/num_lines*100 << " % of all the caches)\n";
+    std::cout << "number of inclusion victims: " << num_inclusion_victims << "\n";
+  }
 
-  if (m_config.get_mem_hierarchy() == static_cast<int>(Hierarchy::SINGLE_LEVEL)) {
-    m_l1u_cache->print_stats();
-  } else if (m_config.get_mem_hierarchy() == static_cast<int>(Hierarchy::MULTI_LEVEL)) {
-    m_l1u_cache->print_stats();
-    m_l2_cache->print_stats();
+  if (!m_levels.empty()) {
+    counter num_ifetch_misses = 0, ifetch_stall_cycles = 0;
+    counter num_data_misses = 0, data_stall_cycles = 0;
+    for (int core = 0; core < m_num_cores; ++core) {
+      num_ifetch_misses += m_num_ifetch_misses[core];
+      ifetch_stall_cycles += m_ifetch_stall_cycles[core];
+      num_data_misses += m_num_data_misses[core];
+      data_stall_cycles += m_data_stall_cycles[core];
+    }
+    std::cout << "number of IFETCH misses: " << num_ifetch_misses << "\n";
+    std::cout << "IFETCH miss stall cycles: " << ifetch_stall_cycles << "\n";
+    std::cout << "average IFETCH miss stall: "
+              << (num_ifetch_misses ? (double)ifetch_stall_cycles/num_ifetch_misses : 0) << "\n";
+    std::cout << "number of data misses: " << num_data_misses << "\n";
+    std::cout << "data miss stall cycles: " << data_stall_cycles << "\n";
+    std::cout << "average data miss stall: "
+              << (num_data_misses ? (double)data_stall_cycles/num_data_misses : 0) << "\n";
   }
+
+  m_dram->print_stats();
 }
 
 void memory_hierarchy_c::dump(bool is_file) {
-  if (m_l1u_cache) m_l1u_cache->dump_tag_store(is_file);
-  if (m_l1i_cache) m_l1i_cache->dump_tag_store(is_file);
-  if (m_l1d_cache) m_l1d_cache->dump_tag_store(is_file);
-  if (m_l2_cache)  m_l2_cache->dump_tag_store(is_file);
+  for (auto cache : m_l1i_caches) cache->dump_tag_store(is_file);
+  for (auto& level : m_levels) {
+    for (auto cache : level) cache->dump_tag_store(is_file);
+  }
 }
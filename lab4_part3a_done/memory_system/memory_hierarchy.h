@@ -7,60 +7,122 @@
 #include "atom/mem_req.h"
 #include "memory_controller/simple_mem.h"
 #include "cache.h"
+#include "mem_link.h"
 #include "config.h"
 
+#include <functional>
+#include <string>
 #include <vector>
 
+/// mem_hierarchy in the config file (used when there are no cache_level lines)
 enum class Hierarchy {
   DRAM_ONLY,
   SINGLE_LEVEL,
   MULTI_LEVEL
 };
 
+enum class MemoryModel {
+  SIMPLE,
+  DRAM
+};
+
 // forward declaration
 class cache_c;
 class simple_mem_c;
 
 class memory_hierarchy_c {
 public:
-  memory_hierarchy_c(config_c& config);       
+  memory_hierarchy_c(config_c& config, int num_cores = 1);
   ~memory_hierarchy_c();         
 
+  static std::string check(const config_c& config, int num_cores);  ///< why the hierarchy cannot be built ("": it can)
+
   void init(config_c& config);                 ///< initialize memory hierarchy
-  bool access(addr_t addr, int access_type);   ///< access function
+  bool access(addr_t addr, int access_type, int core_id = 0, uint32_t* req_id = nullptr, uint32_t size = 0);  ///< access function
+  int  access_batch(const mem_access_s* accesses, int num, int core_id = 0, uint32_t* req_ids = nullptr);  ///< accesses sent in the same cycle; how many were sent
   void run_a_cycle();                          ///< tick a cycle
 
-  config_c m_config;
+  // fast-forward: functional accesses that only warm the caches
+  void begin_fast_forward();
+  int  warm(addr_t addr, int access_type, int core_id = 0);  ///< no request, no time, no stats kept; the level that served it
+  void end_fast_forward(bool reset_stats = true);  ///< back to timing; the statistics start over
+
+  // L1 filter: record what leaves the L1s, replay it below them
+  void set_l1_out_func(std::function<void(mem_req_s*, bool)> cb);  ///< called for each request leaving an L1 (to_memory: write-back straight to memory)
+  void access_below_l1(addr_t addr, int access_type, uint32_t size, int pf_level, bool dirty, bool to_memory);  ///< a request recorded below the L1s
+  counter get_cycle() const { return m_cycle; }
 
-  static const int cache_types = 4;
+  config_c m_config;
                                                
 private:
-  mem_req_s* create_mem_req(addr_t address, int access_type);
+  mem_req_s* create_mem_req(addr_t address, int access_type, int core_id, uint32_t size = 0);
   void free_mem_req(mem_req_s* req);
+  void send_to_top(mem_req_s* req);            ///< the L1 (or memory) port for the request type
+  void send_to_dram(mem_req_s* req);           ///< main memory, or the wait queue if it is full
+  void retry_dram();                           ///< resend the requests main memory refused
+  cache_c* get_top_cache(int access_type, int core_id);  ///< L1 for the request type (nullptr: no cache)
+
+  std::vector<std::vector<mem_req_s*> > m_free_reqs;  ///< freed requests to reuse (per core)
+  std::vector<std::vector<mem_req_s*> > m_batch_reqs; ///< requests of the batch being sent (per core)
 
-  counter m_mem_req_id;                        ///< memory request id to assign
+  std::vector<counter> m_core_req_id;          ///< memory request id to assign (per core)
   simple_mem_c* m_dram;                        ///< simple main memory
+  queue_c* m_dram_wait_queue;                  ///< requests main memory could not take yet (in order)
   counter m_cycle;                             ///< clock cycle
-  cache_c** caches[4];
+  std::vector<counter> m_num_ifetch_misses;    ///< # REQ_IFETCH slower than an L1 hit (per core)
+  std::vector<counter> m_ifetch_stall_cycles;  ///< cycles REQ_IFETCH spent beyond the L1 hit latency (per core)
+  std::vector<counter> m_num_data_misses;      ///< # data requests slower than an L1 hit (per core)
+  std::vector<counter> m_data_stall_cycles;    ///< cycles data requests spent beyond the L1 hit latency (per core)
                                                
 public:
   void dump(bool is_file);                     ///< dump the data in cache after simulation
 
   void process_done_req();
+  void process_done_req(int core_id);
   void push_done_req(mem_req_s* req);
   bool is_wb_done();
   void print_stats();
-  int  get_num_in_flight_reqs(void) { return m_in_flight_reqs.size(); }
+  int  get_num_in_flight_reqs(void) {
+    int num_reqs = 0;
+    for (auto num : m_core_in_flight) num_reqs += num;
+    return num_reqs;
+  }
+  int  get_num_in_flight_reqs(int core_id) { return m_core_in_flight[core_id]; }
+  int  get_num_cores(void) { return m_num_cores; }
+  std::vector<cache_c*> get_caches();          ///< all the caches, in the order of print_stats()
+  bool is_l1_split(void) { return !m_l1i_caches.empty(); }  ///< separate L1I and L1D ports
+  int  get_hit_latency(int access_type);       ///< latency of an L1 hit for the request type (0: no cache)
+  int  get_line_size(int access_type);         ///< line size of the L1 for the request type
+  void set_core_done_func(int core_id, std::function<void(mem_req_s*)> cb) { m_core_done_funcs[core_id] = std::move(cb); }
+  void set_core_batch_done_func(int core_id, std::function<void(mem_req_s* const*, int)> cb) { m_core_batch_done_funcs[core_id] = std::move(cb); }
+  counter get_core_cycle(int core_id);         ///< current cycle as seen by a core
+  bool is_core_idle(int core_id);
+
+  // parallel multi-core simulation
+  void enable_parallel();
+  int  get_lookahead();
+  void run_core_cycle(int core_id);            ///< a core's L1 (core thread)
+  void run_shared_cycle();                     ///< L2 and main memory (shared thread)
+  size_t get_num_sent_to_core(int core_id);
+  bool is_shared_wb_done();
                                               
 private:
-  cache_c* m_l1u_cache;                        ///< l1u_cache for unified I/D
-  cache_c* m_l1i_cache;                        ///< l1i_cache
-  cache_c* m_l1d_cache;                        ///< l1d_cache 
+  cache_c* get_cache(int level, int core_id) { return m_levels[level][m_level_shared[level] ? 0 : core_id]; }
+  std::vector<cache_c*> get_private_caches(int level, int core_id);  ///< with the L1I at level 0
 
-  cache_c* m_l2_cache;                         ///< l2_cache
+  std::vector<std::vector<cache_c*> > m_levels;  ///< caches of each level from the top (one per core if private)
+  std::vector<bool> m_level_shared;            ///< the level is one cache shared by all the cores
+  int m_num_private_levels;                    ///< the private levels come first
+  std::vector<cache_c*> m_l1i_caches;          ///< L1 instruction cache of each core (empty: unified L1)
                                                
-  std::vector<mem_req_s*> m_in_flight_reqs;    ///< memory requests in the memory hierarchy
-  queue_c* m_done_queue;                       ///< holds the requests that are done (i.e., data ready for the core)
+  int m_num_cores;                             ///< # cores sharing the hierarchy
+  std::vector<int> m_core_in_flight;           ///< # in-flight requests of each core
+  std::vector<queue_c*> m_done_queues;         ///< holds the requests that are done (i.e., data ready for the core), per core
+  std::vector<std::function<void(mem_req_s*)> > m_core_done_funcs;  ///< a core's callback for its done requests (optional)
+  std::vector<std::function<void(mem_req_s* const*, int)> > m_core_batch_done_funcs;  ///< called once per cycle with all of them (optional)
+
+  std::vector<link_c*> m_down_links;           ///< core's last private level -> shared levels (parallel simulation)
+  std::vector<link_c*> m_up_links;             ///< shared levels -> core's last private level (parallel simulation)
 };
 
 #endif // !__MEMORY_HIERARCHY_H__
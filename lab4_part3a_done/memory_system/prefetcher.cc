@@ -0,0 +1,190 @@
+// ECE 430.322: Computer Organization
+// Lab 4: Memory System Simulation
+
+#include "prefetcher.h"
+
+#include "atom/mem_req.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+
+prefetcher_c::prefetcher_c(int line_size, int degree) {
+  m_line_size = line_size;
+  m_degree = degree;
+}
+
+/**
+ * This creates a prefetcher engine.
+ * @param type - PREFETCHER_TYPE from the config file
+ * @param return nullptr for PREF_NONE.
+ */
+prefetcher_c* prefetcher_c::create(int type, int line_size, int degree) {
+  switch (type) {
+    case PREF_NONE:      return nullptr;
+    case PREF_NEXT_LINE: return new next_line_prefetcher_c(line_size, degree);
+    case PREF_STRIDE:    return new stride_prefetcher_c(line_size, degree);
+    case PREF_STREAM:    return new stream_prefetcher_c(line_size, degree);
+    case PREF_IFETCH:    return new ifetch_prefetcher_c(line_size, degree);
+  }
+  assert(0 && "unknown prefetcher type");
+  return nullptr;
+}
+
+///////////////////////////////////////////////////////////////////
+void next_line_prefetcher_c::on_miss(addr_t addr, int) {
+  int64_t line = addr / m_line_size;
+  for (int ii = 1; ii <= m_degree; ++ii) {
+    issue(line + ii);
+  }
+}
+
+///////////////////////////////////////////////////////////////////
+stride_prefetcher_c::stride_prefetcher_c(int line_size, int degree)
+    : prefetcher_c(line_size, degree) {
+  m_table.assign(num_entries, entry_s{false, 0, 0, 0, 0});
+}
+
+void stride_prefetcher_c::on_access(addr_t addr, int, bool) {
+  addr_t region = addr >> region_bits;
+  entry_s& entry = m_table[region % num_entries];
+
+  if (!entry.m_valid || entry.m_region != region) {
+    entry = entry_s{true, region, addr, 0, 0};
+    return;
+  }
+
+  int64_t stride = (int64_t)addr - (int64_t)entry.m_last_addr;
+  entry.m_last_addr = addr;
+  if (stride == 0) return;
+
+  if (stride == entry.m_stride) {
+    if (entry.m_confidence < 3) entry.m_confidence++;
+  } else {
+    if (entry.m_confidence > 0) entry.m_confidence--;
+    if (entry.m_confidence == 0) entry.m_stride = stride;
+  }
+
+  if (entry.m_confidence < 2) return;
+
+  // strides smaller than a line still move forward one line at a time
+  int64_t line = addr / m_line_size;
+  int64_t step = entry.m_stride / m_line_size;
+  if (step == 0) step = (entry.m_stride > 0) ? 1 : -1;
+
+  for (int ii = 1; ii <= m_degree; ++ii) {
+    issue(line + step * ii);
+  }
+}
+
+///////////////////////////////////////////////////////////////////
+stream_prefetcher_c::stream_prefetcher_c(int line_size, int degree)
+    : prefetcher_c(line_size, degree) {
+  m_streams.assign(num_streams, stream_s{false, 0, 0, 1, 0});
+  m_timestamp = 0;
+}
+
+void stream_prefetcher_c::on_access(addr_t addr, int, bool) {
+  int64_t line = addr / m_line_size;
+
+  for (auto& stream : m_streams) {
+    if (!stream.m_valid) continue;
+
+    // is the line inside the window [head, tail] in the stream direction?
+    int64_t from_head = (line - stream.m_head) * stream.m_dir;
+    int64_t to_tail   = (stream.m_tail - line) * stream.m_dir;
+    if (from_head < 0 || to_tail < 0) continue;
+
+    stream.m_head = line + stream.m_dir;
+    stream.m_lru = ++m_timestamp;
+
+    // keep "degree" lines prefetched ahead of the demand stream
+    while ((stream.m_tail - line) * stream.m_dir < m_degree) {
+      stream.m_tail += stream.m_dir;
+      issue(stream.m_tail);
+    }
+    return;
+  }
+}
+
+void stream_prefetcher_c::on_miss(addr_t addr, int) {
+  int64_t line = addr / m_line_size;
+
+  // a miss inside an existing stream is handled by on_access
+  for (auto& stream : m_streams) {
+    if (!stream.m_valid) continue;
+    if ((line - stream.m_head) * stream.m_dir >= 0 &&
+        (stream.m_tail - line) * stream.m_dir >= 0) return;
+  }
+
+  for (auto it = m_recent_misses.begin(); it != m_recent_misses.end(); ++it) {
+    int64_t distance = line - *it;
+    if (distance == 0 || std::abs(distance) > train_distance) continue;
+
+    // allocate a stream in the LRU slot
+    stream_s* victim = &m_streams[0];
+    for (auto& stream : m_streams) {
+      if (!stream.m_valid) { victim = &stream; break; }
+      if (stream.m_lru < victim->m_lru) victim = &stream;
+    }
+
+    victim->m_valid = true;
+    victim->m_dir = (distance > 0) ? 1 : -1;
+    victim->m_head = line + victim->m_dir;
+    victim->m_tail = line;
+    victim->m_lru = ++m_timestamp;
+    for (int ii = 0; ii < m_degree; ++ii) {
+      victim->m_tail += victim->m_dir;
+      issue(victim->m_tail);
+    }
+
+    m_recent_misses.erase(it);
+    return;
+  }
+
+  m_recent_misses.push_back(line);
+  if (m_recent_misses.size() > num_streams) m_recent_misses.erase(m_recent_misses.begin());
+}
+
+///////////////////////////////////////////////////////////////////
+ifetch_prefetcher_c::ifetch_prefetcher_c(int line_size, int depth)
+    : prefetcher_c(line_size, depth) {
+  m_last_line = -1;
+  m_pf_line = -1;
+  m_run_length = 0;
+
+  m_num_runs = 0;
+  m_num_run_lines = 0;
+}
+
+void ifetch_prefetcher_c::on_access(addr_t addr, int type, bool) {
+  if (type != REQ_IFETCH) return;
+
+  int64_t line = addr / m_line_size;
+  if (line == m_last_line) return;
+
+  if (m_last_line != -1 && line == m_last_line + 1) {
+    m_run_length++;
+    m_num_run_lines++;
+  } else {
+    // discontinuity: start a new run at the target line
+    m_run_length = 0;
+    m_pf_line = line;
+    m_num_runs++;
+  }
+  m_last_line = line;
+
+  if (m_run_length < run_threshold) return;
+
+  for (int64_t pf_line = std::max(m_pf_line, line) + 1; pf_line <= line + m_degree; ++pf_line) {
+    issue(pf_line);
+  }
+  m_pf_line = std::max(m_pf_line, line + m_degree);
+}
+
+void ifetch_prefetcher_c::print_stats() {
+  std::cout << "number of fetch discontinuities: " << m_num_runs << "\n";
+  std::cout << "average sequential run length (lines): "
+            << (m_num_runs ? (double)(m_num_run_lines + m_num_runs)/m_num_runs : 0) << "\n";
+}
@@ -0,0 +1,152 @@
+// ECE 430.322: Computer Organization
+// Lab 4: Memory System Simulation
+
+#ifndef __PREFETCHER_H__
+#define __PREFETCHER_H__
+
+#include "atom/global.h"
+
+#include <vector>
+
+enum PREFETCHER_TYPE {
+  PREF_NONE = 0,       ///< no prefetcher
+  PREF_NEXT_LINE,      ///< next-N-line
+  PREF_STRIDE,         ///< per-region stride
+  PREF_STREAM,         ///< stream buffers
+  PREF_IFETCH,         ///< instruction-stream (sequential fetch runs)
+  PREF_LAST
+};
+
+/***
+ *
+ * @class prefetcher (prefetcher_c)
+ *
+ * This is the interface of a hardware prefetcher attached to a cache_c. The
+ * cache notifies the prefetcher on every demand access (on_access) and on
+ * every demand miss (on_miss). The prefetcher answers with line addresses to
+ * prefetch in m_candidates, and the cache turns them into prefetch requests.
+ */
+class prefetcher_c {
+public:
+  prefetcher_c(int line_size, int degree);
+  virtual ~prefetcher_c() {}
+
+  virtual void on_access(addr_t, int, bool) {}  ///< every demand access (address, type, hit)
+  virtual void on_miss(addr_t, int) {}          ///< every demand miss (address, type)
+  virtual void print_stats() {}
+
+  static prefetcher_c* create(int type, int line_size, int degree);
+
+  std::vector<addr_t> m_candidates;  ///< line addresses to prefetch (drained by the cache)
+
+protected:
+  void issue(int64_t line) { if (line >= 0) m_candidates.push_back(line * m_line_size); }
+
+  int m_line_size;                   ///< cache line size
+  int m_degree;                      ///< # lines to prefetch per trigger
+};
+
+/***
+ *
+ * @class next-N-line prefetcher (next_line_prefetcher_c)
+ *
+ * On a miss to line X, this prefetches lines X+1 ... X+degree.
+ */
+class next_line_prefetcher_c : public prefetcher_c {
+public:
+  next_line_prefetcher_c(int line_size, int degree) : prefetcher_c(line_size, degree) {}
+
+  void on_miss(addr_t addr, int type) override;
+};
+
+/***
+ *
+ * @class per-region stride prefetcher (stride_prefetcher_c)
+ *
+ * This tracks the last address and stride of each memory region (e.g., a 4KB
+ * page) in a direct-mapped table. Once the same stride has been seen twice
+ * in a row, the next "degree" strided lines are prefetched on every access.
+ */
+class stride_prefetcher_c : public prefetcher_c {
+public:
+  stride_prefetcher_c(int line_size, int degree);
+
+  void on_access(addr_t addr, int type, bool hit) override;
+
+  static const int num_entries = 64;     ///< # regions tracked
+  static const int region_bits = 12;     ///< region size (4KB)
+
+private:
+  struct entry_s {
+    bool    m_valid;
+    addr_t  m_region;                    ///< region number (tag)
+    addr_t  m_last_addr;                 ///< last address accessed in the region
+    int64_t m_stride;                    ///< last observed stride
+    int     m_confidence;                ///< saturating counter (0-3)
+  };
+
+  std::vector<entry_s> m_table;
+};
+
+/***
+ *
+ * @class stream-buffer prefetcher (stream_prefetcher_c)
+ *
+ * Two misses to neighboring lines allocate a stream in that direction. A
+ * stream keeps "degree" lines prefetched ahead of the demand stream; when a
+ * demand access falls into the prefetched window, the window slides forward.
+ * Streams are replaced in LRU order.
+ */
+class stream_prefetcher_c : public prefetcher_c {
+public:
+  stream_prefetcher_c(int line_size, int degree);
+
+  void on_access(addr_t addr, int type, bool hit) override;
+  void on_miss(addr_t addr, int type) override;
+
+  static const int num_streams = 8;      ///< # stream buffers
+  static const int train_distance = 4;   ///< max distance (in lines) between training misses
+
+private:
+  struct stream_s {
+    bool    m_valid;
+    int64_t m_head;                      ///< next line the demand stream is expected to touch
+    int64_t m_tail;                      ///< last line prefetched
+    int     m_dir;                       ///< +1 ascending, -1 descending
+    counter m_lru;                       ///< last use (for replacement)
+  };
+
+  std::vector<stream_s> m_streams;
+  std::vector<int64_t> m_recent_misses;  ///< recent miss lines for training
+  counter m_timestamp;
+};
+
+/***
+ *
+ * @class instruction-stream prefetcher (ifetch_prefetcher_c)
+ *
+ * This follows the instruction fetch stream line by line. A fetch to the line
+ * right after the previous one extends the current sequential run; any other
+ * line change is a discontinuity (taken branch, call, return) that ends the
+ * run and restarts the prefetch window at the new line. Once a run is
+ * confirmed, the prefetcher keeps "depth" lines ahead of the fetch line.
+ */
+class ifetch_prefetcher_c : public prefetcher_c {
+public:
+  ifetch_prefetcher_c(int line_size, int depth);
+
+  void on_access(addr_t addr, int type, bool hit) override;
+  void print_stats() override;
+
+  static const int run_threshold = 1;    ///< sequential line steps before prefetching
+
+private:
+  int64_t m_last_line;                   ///< last fetched line (-1: none yet)
+  int64_t m_pf_line;                     ///< furthest line prefetched in this run
+  int     m_run_length;                  ///< sequential line steps in the current run
+
+  counter m_num_runs;                    ///< # sequential runs (i.e., discontinuities + 1)
+  counter m_num_run_lines;               ///< # sequential line steps over all runs
+};
+
+#endif // !__PREFETCHER_H__
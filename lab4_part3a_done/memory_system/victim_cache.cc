@@ -0,0 +1,98 @@
+// ECE 430.322: Computer Organization
+// Lab 4: Memory System Simulation
+
+#include "victim_cache.h"
+
+#include "atom/mem_req.h"
+
+#include <cassert>
+#include <iostream>
+
+victim_cache_c::victim_cache_c(std::string name, int num_entries, int line_size, int latency)
+    : cache_base_c(name, 1, num_entries, line_size) {
+  assert(num_entries > 0 && num_entries <= 100 && "the LRU stack of a set holds at most 100 entries");
+
+  m_latency = latency;
+  m_evicted = false;
+  m_evicted_addr = 0;
+  m_evicted_dirty = false;
+  m_num_probes = 0;
+  m_num_hits = 0;
+  m_num_inserts = 0;
+  m_num_evictions = 0;
+}
+
+/**
+ * This looks up a line missed in the L1. A hit moves the line out of the
+ * victim cache (it goes back to the L1) and returns its state.
+ */
+bool victim_cache_c::lookup(addr_t address, bool& dirty, bool& shared) {
+  m_num_probes++;
+  cache_entry_c* entry = find_entry(address);
+  if (!entry) return false;
+
+  m_num_hits++;
+  dirty = entry->m_dirty;
+  shared = entry->m_shared;
+  entry->m_valid = false;
+  entry->m_dirty = false;
+  return true;
+}
+
+/**
+ * This inserts a line evicted from the L1. If the victim cache is full, its
+ * LRU line is evicted and returned.
+ */
+bool victim_cache_c::insert(addr_t address, bool dirty, bool shared, addr_t& evicted_addr, bool& evicted_dirty) {
+  m_evicted = false;
+  cache_base_c::access(address, FILL_INCLUDE, true);
+  m_num_inserts++;
+
+  cache_entry_c* entry = find_entry(address);
+  entry->m_dirty = dirty;
+  entry->m_shared = shared;
+
+  if (!m_evicted) return false;
+
+  m_num_evictions++;
+  evicted_addr = m_evicted_addr;
+  evicted_dirty = m_evicted_dirty;
+  return true;
+}
+
+/**
+ * With a single set, the tag is the whole line number, so it needs all the
+ * bits of addr_t: the address of the evicted line is rebuilt from it.
+ */
+bool victim_cache_c::evict_and_bring_new(int set_idx, addr_t tag, int req_type, bool set_dirty) {
+  bool evicted, dirty_evicted; addr_t evicted_tag;
+  m_set[set_idx]->evict_and_bring_new(tag, set_dirty, evicted, dirty_evicted, evicted_tag);
+
+  m_evicted = evicted;
+  m_evicted_addr = evicted_tag * m_line_size;
+  m_evicted_dirty = evicted && dirty_evicted;
+  return m_evicted_dirty;
+}
+
+void victim_cache_c::reset_stats() {
+  cache_base_c::reset_stats();
+  m_num_probes = 0;
+  m_num_hits = 0;
+  m_num_inserts = 0;
+  m_num_evictions = 0;
+}
+
+/**
+ * The hit rate is over the L1 misses that probed the victim cache (the
+ * inserts are not accesses).
+ */
+void victim_cache_c::print_stats() {
+  std::cout << "------------------------------" << "\n";
+  std::cout << m_name << " Hit Rate: "        << (m_num_probes ? (double)m_num_hits/m_num_probes*100 : 0) << " % \n";
+  std::cout << "------------------------------" << "\n";
+  std::cout << "number of probes: "           << m_num_probes << "\n";
+  std::cout << "number of hits: "             << m_num_hits << "\n";
+  std::cout << "number of victims inserted: " << m_num_inserts << "\n";
+  std::cout << "number of lines evicted: "    << m_num_evictions << "\n";
+  std::cout << "number of writebacks: "       << get_num_writebacks() << "\n";
+}
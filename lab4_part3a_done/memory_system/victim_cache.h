@@ -0,0 +1,50 @@
+// ECE 430.322: Computer Organization
+// Lab 4: Memory System Simulation
+
+#ifndef __VICTIM_CACHE_H__
+#define __VICTIM_CACHE_H__
+
+#include "atom/global.h"
+#include "./cache_base/cache_base.h"
+
+#include <string>
+
+/***
+ *
+ * @class victim cache (victim_cache_c)
+ *
+ * This is a small fully associative (one set, LRU) buffer that holds the
+ * lines evicted from an L1. The L1 probes it on a miss in parallel with the
+ * next level: on a hit, the line is swapped back into the L1 after the
+ * victim cache latency, and the next-level access is not needed. A line
+ * leaves the L1 (write-back, eviction notice) only when the victim cache
+ * evicts it.
+ */
+class victim_cache_c : public cache_base_c {
+public:
+  victim_cache_c(std::string name, int num_entries, int line_size, int latency);
+
+  bool lookup(addr_t addr, bool& dirty, bool& shared);  ///< on a hit, the line leaves the victim cache
+  bool insert(addr_t addr, bool dirty, bool shared, addr_t& evicted_addr, bool& evicted_dirty);  ///< true if a line was evicted
+  cache_entry_c* find_line(addr_t addr) { return find_entry(addr); }
+  int get_latency() const { return m_latency; }
+  void print_stats();
+  void reset_stats();
+
+protected:
+  bool evict_and_bring_new(int set_idx, addr_t tag, int req_type, bool set_dirty) override;
+
+private:
+  int m_latency;                ///< hit latency (after the L1 miss is known)
+
+  bool   m_evicted;             ///< the last insert evicted a line
+  addr_t m_evicted_addr;        ///< line evicted by the last insert
+  bool   m_evicted_dirty;       ///< the line evicted by the last insert was dirty
+
+  counter m_num_probes;         ///< # L1 misses looked up
+  counter m_num_hits;           ///< # L1 misses found here
+  counter m_num_inserts;        ///< # L1 victims inserted
+  counter m_num_evictions;      ///< # lines that left the L1 through the victim cache
+};
+
+#endif // !__VICTIM_CACHE_H__